@@ -31,5 +31,6 @@
 #include "cds/tools/tools.hpp"
 #include "cds/math/math.hpp"
 #include "cds/tv/tv.hpp"
+#include "cds/inpainting/inpainting.hpp"
 
 #endif  // LIB_CDS_HPP
@@ -0,0 +1,63 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_EXEMPLAR_HPP
+#define CDS_EXEMPLAR_HPP
+
+#include <opencv2/core/core.hpp>
+
+namespace cds
+{
+  /**
+   * Fills the missing pixels of g by copying patches of the known part of the image, which
+   * reconstructs the textures and the structures of large holes where TV inpainting only
+   * produces smooth fills.
+   * The completion is solved coarse to fine as in [1]: on each level, the nearest-neighbor field
+   * between the patches that overlap the hole and the fully known patches is updated with
+   * PatchMatch [2], then each missing pixel becomes the weighted mean of the values that the
+   * matched patches propose for it. The field and the image are upsampled to initialize the next
+   * level, and the coarsest level is initialized by TvInpainting. A level where the fully known
+   * patches are too few to copy from (scattered missing pixels) keeps the smooth fill.
+   * The propagation of PatchMatch runs on bands of rows in parallel, each band reading its
+   * neighbors outside of the band from the previous pass, so the result does not depend on the
+   * number of threads. The cost is nearly linear in the number of pixels.
+   *
+   * [1] Wexler, Y., Shechtman, E., Irani, M. (2007). Space-Time Completion of Video.
+   * IEEE Transactions on Pattern Analysis and Machine Intelligence, 29(3), 463–476.
+   * [2] Barnes, C., Shechtman, E., Finkelstein, A., Goldman, D. B. (2009). PatchMatch: A Randomized
+   * Correspondence Algorithm for Structural Image Editing. ACM Transactions on Graphics, 28(3).
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1 (shared by all the channels),
+   *             0 on the missing pixels as for TvInpainting
+   * @param u The resulting image, of the same type as g, equal to g on the known pixels
+   * @param iterations The number of matching and voting steps on each level (3-10 are good values)
+   * @param levels The maximal number of levels of the pyramid, including the full resolution
+   *               (coarsening stops when the image becomes too small for the patches)
+   * @param patchRadius Radius of the patches (2-4 are good values)
+   */
+  void ExemplarInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations = 5, int levels = 6,
+                          int patchRadius = 3);
+}
+
+#endif  // CDS_EXEMPLAR_HPP
@@ -30,15 +30,16 @@ namespace cds
 {
 	/**
 	 * Divergence of a vector field defines by its 2 components X1 and X2, using a backward scheme
-	 * @param X1 Single-channel, floating-point image of the first component
-	 * @param X2 Single-channel, floating-point image of the first component
-	 * @param divX Single-channel, floating-point image of the divergence of X=(X1,X2)
+	 * The channels of a multichannel field are processed independently.
+	 * @param X1 Floating-point image of the first component
+	 * @param X2 Floating-point image of the first component
+	 * @param divX Floating-point image of the divergence of X=(X1,X2), with the same number of channels
 	 */
 	void DivergenceWithBackwardScheme(cv::Mat const &X1, cv::Mat const &X2, cv::Mat &divX);
 	
 	/**
-	 * Horizontal gradient of a single-channel image X using a forward scheme
-	 * @param[in] X Single-channel, floating-point image
+	 * Horizontal gradient of an image X using a forward scheme (channel by channel)
+	 * @param[in] X Floating-point image
 	 * @param[out] Dx Horizontal component of the gradient of X
 	 * @see HorizontalGradientWithBackwardScheme
 	 * @see HorizontalGradientWithBackwardScheme
@@ -46,24 +47,24 @@ namespace cds
 	void HorizontalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx);
 	
 	/**
-	 * Vertical gradient of a single-channel image X using a forward scheme
-	 * @param[in] X Single-channel, floating-point image
+	 * Vertical gradient of an image X using a forward scheme (channel by channel)
+	 * @param[in] X Floating-point image
 	 * @param[out] Dx Vertical component of the gradient of X
 	 * @see VerticalGradientWithBackwardScheme
 	 */
 	void VerticalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx);
 	
 	/**
-	 * Horizontal gradient of a single-channel image X using a backward scheme
-	 * @param[in] X Single-channel, floating-point image
+	 * Horizontal gradient of an image X using a backward scheme (channel by channel)
+	 * @param[in] X Floating-point image
 	 * @param[out] Dx Horizontal component of the gradient of X
 	 * @see HorizontalGradientWithForwardScheme
 	 */
 	void HorizontalGradientWithBackwardScheme(cv::Mat const &X, cv::Mat &Dx);
 	
 	/**
-	 * Vertical gradient of a single-channel image X using a backward scheme
-	 * @param[in] X Single-channel, floating-point image
+	 * Vertical gradient of an image X using a backward scheme (channel by channel)
+	 * @param[in] X Floating-point image
 	 * @param[out] Dx Vertical component of the gradient of X
 	 * @see VerticalGradientWithForwardScheme
 	 */
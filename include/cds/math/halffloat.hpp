@@ -0,0 +1,138 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_HALFFLOAT_HPP
+#define CDS_HALFFLOAT_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <cstring>
+
+namespace cds
+{
+	// 16-bit floating-point storage, kept in CV_16U matrices (OpenCV 2.x has no half-precision type).
+	// The values are converted to float32 when they are loaded, all the arithmetic is done in float32.
+	
+	/**
+	 * Converts a float to IEEE 754 binary16 (FP16: 1 sign, 5 exponent, 10 mantissa bits),
+	 * rounding to the nearest even value. Overflows give +/-infinity.
+	 */
+	inline ushort FloatToHalf(float f)
+	{
+		unsigned int x;
+		std::memcpy(&x, &f, sizeof(x));
+		
+		unsigned int sign = (x >> 16) & 0x8000u;
+		x &= 0x7fffffffu;
+		
+		// Infinity or NaN
+		if (x >= 0x47800000u)
+		{
+			return (ushort)(sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u));
+		}
+		
+		// Subnormal or zero: the float addition aligns and rounds the mantissa
+		if (x < 0x38800000u)
+		{
+			float magic = 0.5f;
+			float y;
+			std::memcpy(&y, &x, sizeof(y));
+			y += magic;
+			std::memcpy(&x, &y, sizeof(x));
+			return (ushort)(sign | (x - 0x3f000000u));
+		}
+		
+		// Normal: rebias the exponent and round the 13 dropped bits to nearest even
+		unsigned int odd = (x >> 13) & 1u;
+		x += ((15u - 127u) << 23) + 0xfffu + odd;
+		return (ushort)(sign | (x >> 13));
+	}
+	
+	/**
+	 * Converts an IEEE 754 binary16 value to float (exact)
+	 */
+	inline float HalfToFloat(ushort h)
+	{
+		unsigned int const shiftedExponent = 0x7c00u << 13;
+		
+		unsigned int x = (h & 0x7fffu) << 13;
+		unsigned int exponent = x & shiftedExponent;
+		x += (127u - 15u) << 23;
+		
+		float f;
+		
+		if (exponent == shiftedExponent)
+		{
+			// Infinity or NaN
+			x += (128u - 16u) << 23;
+		}
+		else if (exponent == 0)
+		{
+			// Subnormal: renormalize with a float subtraction
+			unsigned int const magicBits = 113u << 23;
+			float magic;
+			std::memcpy(&magic, &magicBits, sizeof(magic));
+			
+			x += 1u << 23;
+			std::memcpy(&f, &x, sizeof(f));
+			f -= magic;
+			std::memcpy(&x, &f, sizeof(x));
+		}
+		
+		x |= (unsigned int)(h & 0x8000u) << 16;
+		std::memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+	
+	/**
+	 * Converts a float to bfloat16 (BF16: the 16 upper bits of a float32),
+	 * rounding to the nearest even value
+	 */
+	inline ushort FloatToBFloat16(float f)
+	{
+		unsigned int x;
+		std::memcpy(&x, &f, sizeof(x));
+		
+		// Keep NaNs quiet, the rounding could turn them into infinities
+		if ((x & 0x7fffffffu) > 0x7f800000u)
+		{
+			return (ushort)((x >> 16) | 0x40u);
+		}
+		
+		x += 0x7fffu + ((x >> 16) & 1u);
+		return (ushort)(x >> 16);
+	}
+	
+	/**
+	 * Converts a bfloat16 value to float (exact)
+	 */
+	inline float BFloat16ToFloat(ushort h)
+	{
+		unsigned int x = (unsigned int)h << 16;
+		float f;
+		std::memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+}
+
+#endif	// CDS_HALFFLOAT_HPP
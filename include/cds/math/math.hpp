@@ -27,5 +27,7 @@
 #include "prox.hpp"
 #include "derivatives.hpp"
 #include "thresholding.hpp"
+#include "halffloat.hpp"
+#include "poisson.hpp"
 
 #endif  // CDS_MATH_HPP
@@ -0,0 +1,61 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_POISSON_HPP
+#define CDS_POISSON_HPP
+
+#include <opencv2/core/core.hpp>
+
+namespace cds
+{
+  /**
+   * Solves the Poisson equation on the missing pixels of an image:
+   * 		div(grad u) = f where the mask is 0, u = g where the mask is 1
+   * with Neumann conditions on the borders of the image. The Laplacian is the one of
+   * DivergenceWithBackwardScheme applied to the forward gradients, i.e. the 5-point stencil.
+   * The system is solved with geometric multigrid V-cycles: the missing pixels of a coarse level
+   * are the 2x2 blocks of missing pixels, the residual is averaged on them and the correction is
+   * interpolated bilinearly, with red-black Gauss-Seidel smoothing (in parallel over the rows).
+   * A cycle costs O(N) and reduces the error by a factor of 4 to 6, whatever the size of the image
+   * and of the holes.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1 (shared by all the channels)
+   * @param f The right-hand side, of the same type as g (e.g. the divergence of a guidance field),
+   *          or an empty matrix for f = 0
+   * @param u The resulting image, of the same type as g. If it has the right size and type, its values
+   *          on the missing pixels are used as a starting point, otherwise they start from the mean
+   *          of the known pixels.
+   * @param cycles The number of V-cycles (5-10 are good values)
+   */
+  void PoissonInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat const &f, cv::Mat &u, int cycles = 8);
+  
+  /**
+   * Harmonic inpainting, PoissonInpainting with f = 0: the smoothest fill of the holes in the
+   * sense of |grad u|^2. It is a good starting point for TvInpainting (see TvSolver::setHarmonicStart),
+   * which otherwise spends most of its iterations propagating the mean intensity into the holes.
+   */
+  void HarmonicInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int cycles = 8);
+}
+
+#endif  // CDS_POISSON_HPP
@@ -25,5 +25,6 @@
 #define CDS_MOTION_HPP
 
 #include "blobs.hpp"
+#include "opticalflow.hpp"
 
 #endif	// CDS_MOTION_HPP
\ No newline at end of file
@@ -0,0 +1,135 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_OPTICALFLOW_HPP
+#define CDS_OPTICALFLOW_HPP
+
+#include <cds/tv/primaldualengine.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+namespace cds
+{
+  /**
+   * Dense TV-L1 optical flow of [1]: the flow u between I0 and I1 minimizes
+   * 		TV(u1) + TV(u2) + lambda * |I1(x + u(x)) - I0(x)|
+   * coarse to fine, with several warps per level where the data term is linearized around the
+   * current flow. As in [1], the flow is decoupled from an auxiliary field v by a quadratic term
+   * |u-v|^2/(2*theta), and each iteration alternates:
+   * - v: pointwise minimization of the linearized data term (thresholding of the residual);
+   * - u: one iteration of the primal-dual ROF solver (primaldualengine.hpp) on the 2 components,
+   *   with the TV of each component (ChannelProjectionL2Ball).
+   * Every step is run in parallel over the rows of the level (bands of the primal-dual engine).
+   * The pyramids, the state of the levels and the primal-dual bands are kept from one call to the
+   * next, so that no memory is allocated for frames of the same size; in a stream of frames, the
+   * pyramid of the previous frame is reused too.
+   *
+   * [1] Zach, C., Pock, T., Bischof, H. (2007). A Duality Based Approach for Realtime TV-L1 Optical
+   * Flow. Pattern Recognition (DAGM), LNCS 4713, 214–223.
+   */
+  class TvL1OpticalFlow
+  {
+  public:
+    /**
+     * @param lambda Weight of the data term, for intensities in [0,1] (20-80 are good values)
+     * @param theta Coupling between u and v (0.1-0.5 are good values)
+     * @param levels The maximal number of levels of the pyramid, including the full resolution
+     *               (coarsening stops at 16 pixels)
+     * @param warps The number of warps on each level
+     * @param iterations The number of iterations per warp
+     */
+    TvL1OpticalFlow(float lambda = 40.0f, float theta = 0.3f, int levels = 5, int warps = 3, int iterations = 20);
+    
+    /**
+     * Computes the flow from I0 to I1, such that I0(x) ~ I1(x + flow(x)).
+     * @param I0 The first image, CV_8UC1 or CV_32FC1 with values in [0,1]
+     * @param I1 The second image, of the same size and type
+     * @param flow The resulting flow, of type CV_32FC2 (horizontal and vertical displacements in
+     *             pixels). If it has the right size and type, it is the starting point (e.g. the flow
+     *             of the previous pair of frames), otherwise the solver starts from 0.
+     */
+    void calc(cv::Mat const &I0, cv::Mat const &I1, cv::Mat &flow);
+    
+    /**
+     * Stream version of calc: computes the flow from the previous frame to this one, reusing the
+     * pyramid of the previous frame. The first frame (or the first one after reset, or after a
+     * change of size) gives a zero flow. As in calc, a flow of the right size and type is the
+     * starting point, so that passing the flow of the previous frame warm-starts the solver.
+     */
+    void operator()(cv::Mat const &frame, cv::Mat &flow);
+    
+    /**
+     * Forgets the previous frame
+     */
+    void reset() { hasPrevious_ = false; }
+    
+  private:
+    /**
+     * Builds the pyramid of an image into the buffers of the given pyramid
+     */
+    void buildPyramid(cv::Mat const &image, std::vector<cv::Mat> &pyramid) const;
+    
+    /**
+     * Flow on the levels of the pyramids I0_ and I1_, from the coarsest one
+     */
+    void solve(cv::Mat &flow);
+    
+    /**
+     * Warps and iterations on a level, starting from flows_[level]
+     */
+    void solveLevel(int level);
+    
+    float lambda_;
+    float theta_;
+    int levels_;
+    int warps_;
+    int iterations_;
+    bool hasPrevious_;
+    
+    // Pyramids of the 2 frames, level 0 is the full resolution
+    std::vector<cv::Mat> I0_;
+    std::vector<cv::Mat> I1_;
+    
+    // State of the levels: flow, auxiliary point and dual variable of the ROF step, auxiliary field
+    std::vector<cv::Mat> flows_;
+    std::vector<cv::Mat> ubar_;
+    std::vector<cv::Mat> p1_;
+    std::vector<cv::Mat> p2_;
+    std::vector<cv::Mat> v_;
+    std::vector<cds::PrimalDualBands> bands_;
+    
+    // Work images of the warps, at full resolution: each level uses their top-left part
+    cv::Mat flow0_;
+    cv::Mat mapX_;
+    cv::Mat mapY_;
+    cv::Mat gradX_;
+    cv::Mat gradY_;
+    cv::Mat warped_;
+    cv::Mat warpedX_;
+    cv::Mat warpedY_;
+  };
+}
+
+#endif  // CDS_OPTICALFLOW_HPP
@@ -50,6 +50,17 @@ namespace cds
    * @param mask The resulting mask of type CV_32FC1
    */
   void CreateRectangularMask(cv::Size frameSize, cv::Rect const &rectangle, cv::Mat &mask); 
+
+  /**
+   * Halves the resolution of an observation with missing pixels, e.g. for coarse-to-fine inpainting.
+   * A coarse pixel is known as soon as one of the fine pixels it covers is known,
+   * and its value is the mean of the known fine pixels.
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1
+   * @param coarseG The resulting image, of size ((cols+1)/2, (rows+1)/2)
+   * @param coarseMask The resulting mask
+   */
+  void DownsampleMaskedImage(cv::Mat const &g, cv::Mat const &mask, cv::Mat &coarseG, cv::Mat &coarseMask);
 }
 
 #endif  // CDS_MASKING_HPP
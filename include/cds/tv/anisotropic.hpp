@@ -0,0 +1,68 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_ANISOTROPIC_HPP
+#define CDS_ANISOTROPIC_HPP
+
+#include <opencv2/core/core.hpp>
+
+namespace cds
+{
+  /**
+   * Solves the 1D Rudin-Osher-Fatemi denoising problem on each row of g independently:
+   * 		min 0.5*lambda*|u-g|^2 + sum |u(x+1) - u(x)|
+   * with the exact direct algorithm of [1] (taut string), in O(N) operations per row in practice.
+   * This is the model for line-scan data, and the building block of TvDenoiseAnisotropic.
+   * The channels are processed independently.
+   *
+   * [1] Condat, L. (2013). A Direct Algorithm for 1-D Total Variation Denoising.
+   * IEEE Signal Processing Letters, 20(11), 1054–1057.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g (may be g)
+   * @param lambda Weight of the data term
+   */
+  void TvDenoiseRows(cv::Mat const &g, cv::Mat &u, float lambda);
+  
+  /**
+   * Solves the Rudin-Osher-Fatemi denoising problem of TvDiffusion with the anisotropic Total
+   * Variation |ux| + |uy| (the model of ProjectionLinfBall, channel by channel):
+   * 		min 0.5*lambda*|u-g|^2 + sum |ux| + |uy|
+   * The TV splits into the TV of the rows and the TV of the columns, whose proximal operators are
+   * solved exactly by TvDenoiseRows (on the transposed image for the columns). They are combined by
+   * the Dykstra-like proximal algorithm of [2]. An outer iteration costs about as much as 8
+   * primal-dual iterations, but 10 to 30 of them reach an accuracy that takes the primal-dual solvers
+   * many hundreds of iterations. The rows, then the columns, are solved in parallel.
+   *
+   * [2] Combettes, P. L., Pesquet, J.-C. (2011). Proximal Splitting Methods in Signal Processing.
+   * Fixed-Point Algorithms for Inverse Problems in Science and Engineering, 185–212.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of outer iterations (each one solves every row and every column once)
+   * @param lambda Weight of the data term
+   */
+  void TvDenoiseAnisotropic(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+}
+
+#endif  // CDS_ANISOTROPIC_HPP
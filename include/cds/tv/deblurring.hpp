@@ -0,0 +1,114 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_DEBLURRING_HPP
+#define CDS_DEBLURRING_HPP
+
+#include <cds/tv/primaldualengine.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+namespace cds
+{
+  /**
+   * TV-L2 deconvolution of an image blurred by a known PSF (motion or defocus blur):
+   * 		min 0.5*lambda*|k*u-g|^2 + TV(u)
+   * solved with algorithm 1 of [1], K being the gradient. The PSF k is applied like cv::filter2D
+   * does (correlation, anchor at the center of the kernel), with periodic boundaries, so that the
+   * blur is diagonal in the Fourier domain and the prox of the data term is exact:
+   * 		u = IDFT( (DFT(v) + tau*lambda*conj(DFT(k))*DFT(g)) / (1 + tau*lambda*|DFT(k)|^2) )
+   * The spectrum of the PSF is computed once per frame size and the one of the data term once per
+   * solve, so that an iteration costs one fused primal-dual sweep (with ProxZeroPixel) plus one
+   * forward and one inverse DFT per channel. cv::dft is fastest for sizes whose prime factors are
+   * 2, 3 and 5 (cv::getOptimalDFTSize).
+   * The workspace is kept from one solve to the next, e.g. for the frames of a video.
+   */
+  class TvDeblurSolver
+  {
+  public:
+    /**
+     * @param psf The point spread function, of type CV_32FC1 and smaller than the frames. It is
+     *            shared by all the channels and should sum to 1.
+     */
+    explicit TvDeblurSolver(cv::Mat const &psf);
+    ~TvDeblurSolver();
+    
+    /**
+     * @param g The blurred image of type CV_32FC1 to CV_32FC4
+     * @param u The resulting image, of the same type as g. If it has the right size and type,
+     *          it is the starting point.
+     * @param iterations The number of iterations of the algorithm (100-500 are good values)
+     * @param lambda Weight of the data term (a few hundred for a mild noise)
+     */
+    void solve(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+    
+  private:
+    // Not copyable, the bands are owned
+    TvDeblurSolver(TvDeblurSolver const &);
+    TvDeblurSolver &operator=(TvDeblurSolver const &);
+    
+    /**
+     * Spectra of the PSF and of the data term, and workspace, for the frames of g
+     */
+    void prepare(cv::Mat const &g, float tauLambda);
+    
+    /**
+     * Applies the prox of the data term to u, and moves ubar accordingly
+     */
+    void proxDataTerm(cv::Mat &u);
+    
+    cv::Mat psf_;
+    
+    cv::Size frameSize_;
+    int type_;
+    cv::Mat psfSpectrum_;		// DFT(k), CV_32FC2
+    cv::Mat denominator_;		// 1/(1 + tau*lambda*|DFT(k)|^2), duplicated in 2 channels
+    float tauLambda_;
+    std::vector<cv::Mat> numerators_;	// tau*lambda*conj(DFT(k))*DFT(g), one per channel
+    
+    cv::Mat ubar_;
+    cv::Mat p1_;
+    cv::Mat p2_;
+    PrimalDualBands *bands_;
+    
+    std::vector<cv::Mat> planes_;
+    cv::Mat spectrum_;
+  };
+  
+  /**
+   * Same as TvDeblurSolver::solve, with a workspace of its own
+   */
+  void TvDeblurring(cv::Mat const &g, cv::Mat const &psf, cv::Mat &u, int iterations, float lambda);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// REFERENCES:																					//
+//																								//
+// [1] Chambolle, A., Pock, T. (2010).	 														//
+//     A First-Order Primal-Dual Algorithm for Convex Problems with Applications to Imaging. 	//
+//     Journal of Mathematical Imaging and Vision, 40(1), 120–145.								//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif	// CDS_DEBLURRING_HPP
@@ -0,0 +1,94 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_NONLOCAL_HPP
+#define CDS_NONLOCAL_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+namespace cds
+{
+  /**
+   * Weighted graph of the non-local TV: each pixel is linked to the pixels of a search window whose
+   * patches are the most similar to its own, stored in CSR form (compressed sparse rows).
+   * Pixel i = y*cols + x has the edges e = offsets[i] to offsets[i+1]-1, going to the pixels
+   * neighbors[e] with the weights weights[e] = sqrt(w(i, neighbors[e])).
+   * The incoming edges are indexed the same way by inOffsets and inEdges (edge numbers), so that
+   * the divergence gathers its terms instead of scattering them.
+   */
+  struct NonLocalGraph
+  {
+    cv::Size frameSize;
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+    std::vector<float> weights;
+    std::vector<int> inOffsets;
+    std::vector<int> inEdges;
+    // Bound of the squared norm of the graph gradient: twice the largest sum of the weights w of
+    // the edges incident to a pixel
+    float normSquared;
+  };
+  
+  /**
+   * Builds the graph of g: each pixel keeps its k nearest neighbors in the search window, for the
+   * mean squared difference d between (2*patchRadius+1)^2 patches (over all the channels), with the
+   * weight w = exp(-d/h^2).
+   * The distances are computed offset by offset with sliding sums over the patches, in
+   * O(N*(2*searchRadius+1)^2) operations instead of O(N*(2*searchRadius+1)^2*(2*patchRadius+1)^2),
+   * in parallel over bands of rows.
+   *
+   * @param g The image, of type CV_32FC1 to CV_32FC4 (usually the noisy image itself)
+   * @param graph The resulting graph
+   * @param neighbors The number k of neighbors of each pixel (5-15 are good values)
+   * @param searchRadius Radius of the search window (5-10 are good values)
+   * @param patchRadius Radius of the patches (1-3 are good values)
+   * @param h Filtering parameter, of the order of the noise level
+   */
+  void BuildNonLocalGraph(cv::Mat const &g, NonLocalGraph &graph, int neighbors = 10, int searchRadius = 7,
+                          int patchRadius = 2, float h = 0.1f);
+  
+  /**
+   * Solves the non-local Rudin-Osher-Fatemi denoising problem:
+   * 		min 0.5*lambda*|u-g|^2 + NLTV(u)
+   * where NLTV(u) = sum_x sqrt( sum_y w(x,y) |u(y)-u(x)|^2 ) over the edges (x,y) of the graph [1],
+   * using the primal-dual scheme of TvDiffusion with one dual value per edge. Textures whose
+   * patches repeat are much better preserved than with the local TV.
+   * An iteration streams once over the edges for the dual step, and once over the outgoing and
+   * incoming edges for the primal step.
+   *
+   * [1] Gilboa, G., Osher, S. (2008). Nonlocal Operators with Applications to Image Processing.
+   * Multiscale Modeling & Simulation, 7(3), 1005–1028.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param graph The graph, built by BuildNonLocalGraph for frames of the size of g
+   * @param u The resulting image, of the same type as g. If it has the right size and type,
+   *          it is the starting point, otherwise the solver starts from g.
+   * @param iterations The number of iterations of the algorithm (50-200 are good values)
+   * @param lambda Weight of the data term
+   */
+  void NonLocalTvDiffusion(cv::Mat const &g, NonLocalGraph const &graph, cv::Mat &u, int iterations, float lambda);
+}
+
+#endif  // CDS_NONLOCAL_HPP
@@ -24,10 +24,18 @@
 #ifndef CDS_PRIMALDUAL_HPP
 #define CDS_PRIMALDUAL_HPP
 
+#include <vector>
 #include <opencv2/core/core.hpp>
 
 namespace cds
 {
+  // The solvers below update horizontal bands of the image in parallel (as many as cv::getNumThreads()),
+  // the result does not depend on the number of threads.
+  // Multichannel images are handled with the vectorial (colour) TV: the norm of the gradient is taken
+  // over all the channels at once, so that the edges are shared instead of smeared channel by channel.
+  // Each call allocates its own workspace: use TvSolver (tvsolver.hpp) to solve a stream of frames.
+  // All of them are instances of the generic engine of primaldualengine.hpp.
+  
   /**
    * Solves the Rudin-Osher-Fatemi denoising problem: 
    * 		min 0.5*lambda*|u-g|^2 + TV(u) 
@@ -35,13 +43,68 @@ namespace cds
    * TV is the isotropic Total Variation sqrt(|ux|^2 + |uy|^2), where ux and uy are the derivatives
    * of u with respect to x and y respectively.
    *
-   * @param g The observed image of type CV_32FC1
-   * @param u The resulting image of type CV_32FC1
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g
    * @param iterations The number of iterations of the algorithm (25-100 are good values)
    * @param lambda Weight of the data term
    */
   void TvDiffusion(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
   
+  /**
+   * Solves the same Rudin-Osher-Fatemi problem as TvDiffusion, using the accelerated primal-dual
+   * scheme (algorithm 2 in [1]).
+   * Since the data term is uniformly convex, theta, tau and sigma are updated at each iteration
+   * and the scheme converges in O(1/N^2) instead of O(1/N), so far fewer iterations are needed
+   * for the same quality.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of iterations of the algorithm (10-50 are good values)
+   * @param lambda Weight of the data term
+   */
+  void TvDiffusionAccelerated(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+  
+  /**
+   * Runs TvDiffusionAccelerated for several values of lambda, e.g. to choose one.
+   * The values are solved in turn, each one starting from the primal and dual variables of the
+   * previous one (see TvSolver::solvePath), which needs 1.5 to 2 times fewer iterations than solves
+   * from scratch for the same accuracy.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param lambdas The weights of the data term, sorted (increasing or decreasing)
+   * @param u The resulting images, one per value of lambda, of the same type as g
+   * @param iterations The number of iterations for each value of lambda
+   */
+  void TvDiffusionPath(cv::Mat const &g, std::vector<float> const &lambdas, std::vector<cv::Mat> &u, int iterations);
+  
+  /**
+   * Solves the TV-L1 denoising problem:
+   * 		min lambda*|u-g|_1 + TV(u)
+   * using the primal-dual scheme in [1]. The L1 data term is robust to impulse (salt and pepper)
+   * noise and removes the structures of the image smaller than about 2/lambda pixels while keeping
+   * the contrast of the others.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of iterations of the algorithm (200-500 are good values)
+   * @param lambda Weight of the data term (0.5-2 are good values)
+   */
+  void TvL1Denoising(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+  
+  /**
+   * Solves the Huber-ROF denoising problem:
+   * 		min 0.5*lambda*|u-g|^2 + sum H_alpha(grad u)
+   * where the Huber function H_alpha is |x|^2/(2*alpha) below alpha and |x| - alpha/2 above,
+   * using the primal-dual scheme in [1]. Smooth gradients are no longer turned into staircases.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of iterations of the algorithm (25-100 are good values)
+   * @param lambda Weight of the data term
+   * @param alpha Threshold of the Huber function (0.01-0.1 for images in [0,1])
+   */
+  void HuberTvDiffusion(cv::Mat const &g, cv::Mat &u, int iterations, float lambda, float alpha);
+  
   /**
    * Solves the TV-L2 inpainting problem: 
    * 		min 0.5*lambda*|Au-g|^2 + TV(u) 
@@ -53,12 +116,70 @@ namespace cds
    * that the result matches perfectly the observation when the mask is not opaque and is free to evolve
    * otherwise.
    *
-   * @param g The observed image of type CV_32FC1
-   * @param mask The mask image, values in {0,1}, of type CV_32FC1
-   * @param u The resulting image of type CV_32FC1
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1 (shared by all the channels)
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of iterations of the algorithm (25-100 are good values)
+   */
+  void TvInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations);
+  
+  /**
+   * Solves the same inpainting problem as TvInpainting, iterating only on a narrow band around the
+   * missing pixels.
+   * The known pixels are set to the observation once and for all, and the dual variable is only
+   * updated where the divergence at a missing pixel depends on it, i.e. on the missing pixels and on
+   * their left and upper neighbors. The cost of an iteration is proportional to the area of the holes
+   * instead of the area of the image. The band is built from the mask at each call.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1 (shared by all the channels)
+   * @param u The resulting image, of the same type as g. If it has the right size and type, its values
+   *          on the missing pixels are used as a starting point.
    * @param iterations The number of iterations of the algorithm (25-100 are good values)
    */
-  void TvInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations);		
+  void TvInpaintingNarrowBand(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations);
+  
+  /**
+   * Solves the same TV-L2 inpainting problem as TvInpainting, coarse to fine.
+   * The observation and the mask are downsampled by 2 up to the requested number of levels,
+   * the problem is solved on the coarsest level first, then the primal and dual variables are
+   * upsampled to initialize the next level.
+   * Large holes are filled much faster this way, since information only travels one pixel
+   * per iteration at a given level.
+   *
+   * @param g The observed image of type CV_32FC1 to CV_32FC4
+   * @param mask The mask image, values in {0,1}, of type CV_32FC1 (shared by all the channels)
+   * @param u The resulting image, of the same type as g
+   * @param iterations The number of iterations on each coarse level
+   * @param levels The number of levels of the pyramid, including the full resolution
+   * @param fineIterations The number of iterations at full resolution (a few tens are usually enough)
+   */
+  void TvInpaintingMultiscale(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations, int levels, int fineIterations);
+  
+  /**
+   * Runs TvDiffusion on a batch of images, from u = 0.
+   * The images are spread over the threads instead of the bands of each image, one at a time so
+   * that batches of mixed sizes stay balanced, and each thread reuses its buffers from one image
+   * to the next. This is much faster than successive calls
+   * to TvDiffusion for many small images.
+   *
+   * @param g The observed images of type CV_32FC1 to CV_32FC4, their size may vary
+   * @param u The resulting images, of the same types as g
+   * @param iterations The number of iterations of the algorithm for each image
+   * @param lambda Weight of the data term
+   */
+  void TvDiffusionBatch(std::vector<cv::Mat> const &g, std::vector<cv::Mat> &u, int iterations, float lambda);
+  
+  /**
+   * Runs TvInpainting on a batch of (image, mask) pairs, from u = 0.
+   * The scheduling is the same as in TvDiffusionBatch.
+   *
+   * @param g The observed images of type CV_32FC1 to CV_32FC4, their size may vary
+   * @param masks The masks of the images, values in {0,1}, of type CV_32FC1 (shared by all the channels)
+   * @param u The resulting images, of the same types as g
+   * @param iterations The number of iterations of the algorithm for each image
+   */
+  void TvInpaintingBatch(std::vector<cv::Mat> const &g, std::vector<cv::Mat> const &masks, std::vector<cv::Mat> &u, int iterations);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
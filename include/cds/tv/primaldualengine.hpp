@@ -0,0 +1,1097 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_PRIMALDUALENGINE_HPP
+#define CDS_PRIMALDUALENGINE_HPP
+
+#include <cds/math/halffloat.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cds
+{
+    // Generic primal-dual engine of the TV solvers, for problems of the form
+    // 		min_u F(K u) + G(u)
+    // solved with algorithms 1 and 2 of [1]. One iteration is a single fused sweep over the rows,
+    // in horizontal bands updated in parallel (see PrimalDualIteration), and everything specific
+    // to a problem is given as a policy, inlined by the compiler in the sweep:
+    // - the operator K: a (weighted) forward gradient, the adjoint being the backward divergence;
+    // - the dual prox, i.e. the prox of F*: a projection for TV, Huber-TV,...
+    // - the primal prox, i.e. the pointwise prox of G: L2 or L1 data term, inpainting, box constraints,...
+    //
+    // Operator policy:
+    // 		void setRow(int y);                      called before the pixels of row y
+    // 		float weight(int x) const;               weight of the gradient at (x, y)
+    // 		float weightAbove(int x) const;          weight of the gradient at (x, y-1)
+    // 		float sigmaScale(int x) const;           factor of the dual step at (x, y)
+    // 		float tauScale(int x) const;             factor of the primal step at (x, y)
+    // 		float normSquared() const;               bound on |K|^2, for the steps
+    // The step factors give diagonal preconditioning, they are 1 for plain scalar steps.
+    // Dual prox policy:
+    // 		template <int CN> void project(float *q1, float *q2, float sigma) const;
+    // 		                                         q1, q2: the CN channels of the 2 components at a pixel
+    // Primal prox policy:
+    // 		void setTau(float tau);
+    // 		void setRow(int y);
+    // 		float operator()(float x, int col, int i) const;
+    // 		                                         i is the index of the value in the row, col its pixel
+    
+    /**
+     * Storage of the auxiliary point ubar and of the dual variable p of the solvers.
+     * With the 16-bit formats, the values are converted to float32 when they are loaded by the
+     * iteration kernel, and rounded (to nearest even) when they are stored, u itself stays in float32.
+     * This halves the memory footprint and traffic of the state (3 of its 4 planes).
+     *
+     * Precision: each stored value has a relative rounding error below 2^-11 (FP16) or 2^-8 (BF16).
+     * Measured PSNR of u with respect to the float32 solver, for images in [0,1] with gaussian noise
+     * (sigma 0.1 to 0.3), ROF with lambda = 4 or 8 and inpainting with 50% of missing pixels:
+     * - TV_STORAGE_FLOAT16: above 78 dB after 10 iterations, 74 dB after 100, 69 dB after 1000
+     * - TV_STORAGE_BFLOAT16: above 60 dB after 10 iterations, 55 dB after 100, 49 dB after 1000
+     * so the FP16 error stays far below 8-bit quantization (PSNR 59 dB), while the BF16 one is of the
+     * same order (larger after many iterations): fine for previews, not for a converged result.
+     * The error slowly grows with the number of iterations, u being always kept in float32.
+     */
+    enum TvStorage
+    {
+      TV_STORAGE_FLOAT32 = 0,
+      TV_STORAGE_FLOAT16 = 1,
+      TV_STORAGE_BFLOAT16 = 2
+    };
+    
+    /**
+     * Storage of ubar and of the dual variable (see TvStorage): the kernels load and store the values
+     * through these, and compute in float32.
+     */
+    struct Float32Storage
+    {
+        typedef float value_type;
+        static float load(float x) { return x; }
+        static float store(float x) { return x; }
+    };
+    
+    struct Float16Storage
+    {
+        typedef ushort value_type;
+        static float load(ushort x) { return cds::HalfToFloat(x); }
+        static ushort store(float x) { return cds::FloatToHalf(x); }
+    };
+    
+    struct BFloat16Storage
+    {
+        typedef ushort value_type;
+        static float load(ushort x) { return cds::BFloat16ToFloat(x); }
+        static ushort store(float x) { return cds::FloatToBFloat16(x); }
+    };
+    
+    //----------
+    // Operators
+    //----------
+    
+    /**
+     * Forward gradient, i.e. the isotropic TV
+     */
+    struct TvOperator
+    {
+        void setRow(int) {}
+        float weight(int) const { return 1.0f; }
+        float weightAbove(int) const { return 1.0f; }
+        float sigmaScale(int) const { return 1.0f; }
+        float tauScale(int) const { return 1.0f; }
+        float normSquared() const { return 8.0f; }
+    };
+    
+    /**
+     * Forward gradient weighted by a non-negative map w, i.e. the weighted TV sum w*|grad u|
+     * (edge-aware regularization when w is small on the edges of a guide image)
+     */
+    class WeightedTvOperator
+    {
+    public:
+        WeightedTvOperator(cv::Mat const &weights)
+        : weights_(weights)
+        {
+            double maxWeight = 0.0;
+            cv::minMaxLoc(weights, 0, &maxWeight);
+            normSquared_ = 8.0f * (float)(maxWeight * maxWeight);
+        }
+        
+        void setRow(int y)
+        {
+            p_w_ = weights_.ptr<float>(y);
+            p_w_above_ = (y > 0 ? weights_.ptr<float>(y-1) : p_w_);
+        }
+        float weight(int x) const { return p_w_[x]; }
+        float weightAbove(int x) const { return p_w_above_[x]; }
+        float sigmaScale(int) const { return 1.0f; }
+        float tauScale(int) const { return 1.0f; }
+        float normSquared() const { return normSquared_; }
+        
+    private:
+        cv::Mat const &weights_;
+        float normSquared_;
+        float const *p_w_;
+        float const *p_w_above_;
+    };
+    
+    /**
+     * Forward gradient with the diagonal preconditioning of [2] (alpha = 1): the steps are scaled at
+     * each pixel by the inverse of the sums of the absolute values of the columns (primal) and rows
+     * (dual) of the operator, so that tau = sigma = 1 converge. Since the two components of the
+     * dual variable at a pixel are projected together, they share the smaller of their two steps.
+     * With an inpainting mask (1 on the known pixels, which are fixed), only the columns of the
+     * missing pixels are counted: the dual steps double on the edges between a known and a missing
+     * pixel, where most of the information of a sparse mask enters.
+     * Steps scaled per pixel are only right with proxes that do not depend on them, i.e. the
+     * projections for the dual and inpainting (or box constraints) for the primal.
+     */
+    class PreconditionedTvOperator
+    {
+    public:
+        /**
+         * @param mask The inpainting mask, or an empty matrix if all the pixels are free
+         */
+        PreconditionedTvOperator(cv::Mat const &mask, cv::Size frameSize)
+        : mask_(mask), rows_(frameSize.height), cols_(frameSize.width), p_mask_(0), p_mask_next_(0), y_(0), vertical_(0)
+        {
+            // Inverses of the numbers of free pixels of an edge and of edges of a pixel (0 never happens
+            // for a pixel, and the dual step of an edge without free pixel does not matter)
+            float const sigmas[3] = { 0.5f, 1.0f, 0.5f };
+            float const taus[5] = { 1.0f, 1.0f, 0.5f, 1.0f / 3.0f, 0.25f };
+            
+            std::copy(sigmas, sigmas + 3, sigmas_);
+            std::copy(taus, taus + 5, taus_);
+        }
+        
+        void setRow(int y)
+        {
+            y_ = y;
+            p_mask_ = (mask_.data ? mask_.ptr<float>(y) : 0);
+            p_mask_next_ = (mask_.data && y+1 < rows_ ? mask_.ptr<float>(y+1) : 0);
+            vertical_ = (y > 0) + (y+1 < rows_);
+        }
+        
+        float weight(int) const { return 1.0f; }
+        float weightAbove(int) const { return 1.0f; }
+        
+        float sigmaScale(int x) const
+        {
+            int freeRight = (x+1 < cols_ ? isFree(p_mask_, x) + isFree(p_mask_, x+1) : 0);
+            int freeBelow = (y_+1 < rows_ ? isFree(p_mask_, x) + isFree(p_mask_next_, x) : 0);
+            return sigmas_[MAX(freeRight, freeBelow)];
+        }
+        
+        float tauScale(int x) const { return taus_[vertical_ + (x > 0) + (x+1 < cols_)]; }
+        float normSquared() const { return 1.0f; }
+        
+    private:
+        static int isFree(float const *p_mask, int x) { return (p_mask && p_mask[x] ? 0 : 1); }
+        
+        cv::Mat mask_;
+        int rows_;
+        int cols_;
+        float sigmas_[3];
+        float taus_[5];
+        float const *p_mask_;
+        float const *p_mask_next_;
+        int y_;
+        int vertical_;
+    };
+    
+    //------------
+    // Dual proxes
+    //------------
+    
+    /**
+     * Projection onto the unit L2 ball at each pixel (isotropic TV), jointly over the channels
+     * (vectorial TV)
+     */
+    struct ProjectionL2Ball
+    {
+        template <int CN>
+        void project(float *q1, float *q2, float) const
+        {
+            float normQ = 0.0f;
+            
+            for (int c = 0; c < CN; ++c)
+            {
+                normQ += q1[c]*q1[c] + q2[c]*q2[c];
+            }
+            
+            normQ = MAX(1.0f, std::sqrt(normQ));
+            
+            for (int c = 0; c < CN; ++c)
+            {
+                q1[c] /= normQ;
+                q2[c] /= normQ;
+            }
+        }
+    };
+    
+    /**
+     * Projection onto the unit L2 ball at each pixel, channel by channel: the sum of the isotropic
+     * TVs of the channels (e.g. of the 2 components of an optical flow). This is the pointwise form
+     * of ProxLinfBall(X1, X2) in prox.hpp.
+     */
+    struct ChannelProjectionL2Ball
+    {
+        template <int CN>
+        void project(float *q1, float *q2, float) const
+        {
+            for (int c = 0; c < CN; ++c)
+            {
+                float normQ = MAX(1.0f, std::sqrt(q1[c]*q1[c] + q2[c]*q2[c]));
+                q1[c] /= normQ;
+                q2[c] /= normQ;
+            }
+        }
+    };
+
+    /**
+     * Projection onto the unit Linf ball (anisotropic TV |ux| + |uy|)
+     */
+    struct ProjectionLinfBall
+    {
+        template <int CN>
+        void project(float *q1, float *q2, float) const
+        {
+            for (int c = 0; c < CN; ++c)
+            {
+                q1[c] = MIN(MAX(-1.0f, q1[c]), 1.0f);
+                q2[c] = MIN(MAX(-1.0f, q2[c]), 1.0f);
+            }
+        }
+    };
+    
+    /**
+     * Prox of the conjugate of the Huber norm with parameter alpha (Huber-TV, see [1] section 6.2.2):
+     * quadratic below alpha, hence no staircasing on smooth gradients
+     */
+    class HuberProjection
+    {
+    public:
+        HuberProjection(float alpha) : alpha_(alpha) {}
+        
+        template <int CN>
+        void project(float *q1, float *q2, float sigma) const
+        {
+            float scale = 1.0f / (1.0f + sigma * alpha_);
+            
+            for (int c = 0; c < CN; ++c)
+            {
+                q1[c] *= scale;
+                q2[c] *= scale;
+            }
+            
+            ProjectionL2Ball().project<CN>(q1, q2, sigma);
+        }
+        
+    private:
+        float alpha_;
+    };
+    
+    //--------------
+    // Primal proxes
+    //--------------
+    
+    /**
+     * Pointwise version of ProxL2: solves argmin { |y-x|^2/(2*tau) + 0.5*lambda*|y-g|^2 }
+     * The value at index i of the row is the channel i-col*channels of pixel col.
+     */
+    class ProxL2Pixel
+    {
+    public:
+        ProxL2Pixel(cv::Mat const &g, float lambda, float tau)
+        : g_(g), lambda_(lambda) { setTau(tau); }
+        
+        void setTau(float tau) { lambdaTau_ = lambda_*tau; scale_ = 1.0f / (1.0f + lambdaTau_); }
+        void setRow(int y) { p_g_ = g_.ptr<float>(y); }
+        float operator()(float x, int, int i) const { return (x + lambdaTau_*p_g_[i]) * scale_; }
+        
+    private:
+        cv::Mat const &g_;
+        float lambda_;
+        float lambdaTau_;
+        float scale_;
+        float const *p_g_;
+    };
+    
+    /**
+     * Pointwise prox of the L1 data term: solves argmin { |y-x|^2/(2*tau) + lambda*|y-g| }
+     * i.e. soft-thresholding of x-g (TV-L1, robust to impulse noise)
+     */
+    class ProxL1Pixel
+    {
+    public:
+        ProxL1Pixel(cv::Mat const &g, float lambda, float tau)
+        : g_(g), lambda_(lambda) { setTau(tau); }
+        
+        void setTau(float tau) { lambdaTau_ = lambda_*tau; }
+        void setRow(int y) { p_g_ = g_.ptr<float>(y); }
+        float operator()(float x, int, int i) const
+        {
+            float d = x - p_g_[i];
+            
+            if (d > lambdaTau_)
+            {
+                return x - lambdaTau_;
+            }
+            if (d < -lambdaTau_)
+            {
+                return x + lambdaTau_;
+            }
+            return p_g_[i];
+        }
+        
+    private:
+        cv::Mat const &g_;
+        float lambda_;
+        float lambdaTau_;
+        float const *p_g_;
+    };
+    
+    /**
+     * Pointwise version of ProxL2Inpainting followed by ProxInterval(0, 1).
+     * The mask has a single channel, shared by all the channels of g.
+     */
+    class ProxInpaintingPixel
+    {
+    public:
+        ProxInpaintingPixel(cv::Mat const &g, cv::Mat const &mask)
+        : g_(g), mask_(mask) {}
+        
+        void setTau(float) {}
+        void setRow(int y) { p_g_ = g_.ptr<float>(y); p_mask_ = mask_.ptr<float>(y); }
+        float operator()(float x, int col, int i) const
+        {
+            if (p_mask_[col])
+            {
+                x = p_g_[i];
+            }
+            return MIN(MAX(0.0f, x), 1.0f);
+        }
+        
+    private:
+        cv::Mat const &g_;
+        cv::Mat const &mask_;
+        float const *p_g_;
+        float const *p_mask_;
+    };
+    
+    /**
+     * Prox of the zero function: the sweep only does the descent step u + tau*K^T(p). This is for
+     * data terms that are not pointwise (e.g. TvDeblurSolver), whose prox is then applied to the whole
+     * frame after the sweep.
+     */
+    struct ProxZeroPixel
+    {
+        void setTau(float) {}
+        void setRow(int) {}
+        float operator()(float x, int, int) const { return x; }
+    };
+    
+    /**
+     * Adds the box constraint xmin <= u <= xmax to a pointwise prox (the prox of a 1D convex function
+     * plus the indicator of an interval is the prox of the function, clamped to the interval)
+     */
+    template <class PrimalProx>
+    class ProxBoxPixel
+    {
+    public:
+        ProxBoxPixel(PrimalProx const &prox, float xmin, float xmax)
+        : prox_(prox), xmin_(xmin), xmax_(xmax) {}
+        
+        void setTau(float tau) { prox_.setTau(tau); }
+        void setRow(int y) { prox_.setRow(y); }
+        float operator()(float x, int col, int i) const { return MIN(MAX(xmin_, prox_(x, col, i)), xmax_); }
+        
+    private:
+        PrimalProx prox_;
+        float xmin_;
+        float xmax_;
+    };
+    
+    //-------
+    // Engine
+    //-------
+    
+    /**
+     * Splits a frame into horizontal bands that are updated in parallel.
+     * Each band keeps a one-row halo on both sides: the old ubar on the row below it,
+     * and the new p2 on the row above it.
+     * With a block depth K > 1 (temporal blocking, see PrimalDualIterations), each band also keeps
+     * copies of the K rows above it and of the K+1 rows below it (ghost rows), so that it can advance
+     * by K iterations without reading the other bands.
+     */
+    class PrimalDualBands
+    {
+    public:
+        PrimalDualBands(cv::Size frameSize, int channels, int maxBands, int storage = TV_STORAGE_FLOAT32, int blockDepth = 1)
+        : storage_(storage), blockDepth_(MAX(1, blockDepth))
+        {
+            // Bands thinner than this are not worth the halo exchange, or the redundant updates of the ghost rows
+            int const minRowsPerBand = MAX(32, 4 * blockDepth_);
+            
+            int count = MIN(maxBands, frameSize.height / minRowsPerBand);
+            count = MAX(1, count);
+            
+            for (int band = 0; band <= count; ++band)
+            {
+                bounds_.push_back((band * frameSize.height) / count);
+            }
+            
+            int depth = (storage == TV_STORAGE_FLOAT32 ? CV_32F : CV_16U);
+            
+            ubarHalo_.create(count, frameSize.width * channels, depth);
+            p2Halo_.create(count, frameSize.width * channels, depth);
+            
+            if (blockDepth_ > 1 && count > 1)
+            {
+                ghostU_.create(count * ghostRows(), frameSize.width * channels, CV_32F);
+                ghostState_.create(3 * count * ghostRows(), frameSize.width * channels, depth);
+            }
+        }
+        
+        int size() const { return (int)bounds_.size() - 1; }
+        int begin(int band) const { return bounds_[band]; }
+        int end(int band) const { return bounds_[band+1]; }
+        int storage() const { return storage_; }
+        int blockDepth() const { return blockDepth_; }
+        
+        template <typename T> T *ubarBelow(int band) { return ubarHalo_.ptr<T>(band); }
+        template <typename T> T *p2Above(int band) { return p2Halo_.ptr<T>(band); }
+        
+        // Ghost row `slot` of a band: slots 0 to K-1 hold the rows begin-K to begin-1, and slots K to 2K
+        // the rows end to end+K. The state planes are 0 for ubar, 1 for p1 and 2 for p2.
+        int ghostRows() const { return 2 * blockDepth_ + 1; }
+        float *ghostU(int band, int slot) { return ghostU_.ptr<float>(band * ghostRows() + slot); }
+        template <typename T> T *ghostState(int band, int plane, int slot) { return ghostState_.ptr<T>((3 * band + plane) * ghostRows() + slot); }
+        
+    private:
+        std::vector<int> bounds_;
+        int storage_;
+        int blockDepth_;
+        cv::Mat ubarHalo_;
+        cv::Mat p2Halo_;
+        cv::Mat ghostU_;
+        cv::Mat ghostState_;
+    };
+    
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualRows(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator op, DualProx const &dualProx, PrimalProx prox,
+                        float tau, float sigma, float theta,
+                        int rowBegin, int rowEnd, typename Storage::value_type const *ubarBelow, typename Storage::value_type const *p2Above);
+    
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualRow(float *p_u, typename Storage::value_type *p_ubar, typename Storage::value_type *p_p1, typename Storage::value_type *p_p2,
+                       typename Storage::value_type const *p_ubar_next, typename Storage::value_type const *p_p2_prev, int y, int rows, int cols,
+                       Operator &op, DualProx const &dualProx, PrimalProx &prox, float tau, float sigma, float theta);
+    
+    template <int CN, class Storage, class Operator, class DualProx>
+    void DualRow(cv::Mat const &ubar, cv::Mat const &p1, cv::Mat const &p2, Operator op, DualProx const &dualProx, float sigma, int y,
+                 typename Storage::value_type *p2Out);
+    
+    /**
+     * First step of a parallel iteration: saves the halos of every band, before any band is updated
+     */
+    template <int CN, class Storage, class Operator, class DualProx>
+    class PrimalDualHalos : public cv::ParallelLoopBody
+    {
+    public:
+        PrimalDualHalos(cv::Mat const &ubar, cv::Mat const &p1, cv::Mat const &p2, Operator const &op, DualProx const &dualProx,
+                        float sigma, PrimalDualBands &bands)
+        : ubar_(ubar), p1_(p1), p2_(p2), op_(op), dualProx_(dualProx), sigma_(sigma), bands_(bands) {}
+        
+        void operator()(cv::Range const &range) const
+        {
+            typedef typename Storage::value_type T;
+            int const valuesPerRow = ubar_.cols * CN;
+            
+            for (int band = range.start; band < range.end; ++band)
+            {
+                int rowBegin = bands_.begin(band);
+                int rowEnd = bands_.end(band);
+                
+                // The band below will overwrite ubar on its first row
+                if (rowEnd < ubar_.rows)
+                {
+                    std::copy(ubar_.ptr<T>(rowEnd), ubar_.ptr<T>(rowEnd) + valuesPerRow, bands_.ubarBelow<T>(band));
+                }
+                
+                // The band above has not updated p2 on its last row yet
+                if (rowBegin > 0)
+                {
+                    cds::DualRow<CN, Storage>(ubar_, p1_, p2_, op_, dualProx_, sigma_, rowBegin-1, bands_.p2Above<T>(band));
+                }
+            }
+        }
+        
+    private:
+        cv::Mat const &ubar_;
+        cv::Mat const &p1_;
+        cv::Mat const &p2_;
+        Operator const &op_;
+        DualProx const &dualProx_;
+        float sigma_;
+        PrimalDualBands &bands_;
+    };
+    
+    /**
+     * Second step of a parallel iteration: updates every band using its halos
+     */
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    class PrimalDualSweep : public cv::ParallelLoopBody
+    {
+    public:
+        PrimalDualSweep(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                        PrimalProx const &prox, float tau, float sigma, float theta, PrimalDualBands &bands)
+        : u_(u), ubar_(ubar), p1_(p1), p2_(p2), op_(op), dualProx_(dualProx), prox_(prox),
+          tau_(tau), sigma_(sigma), theta_(theta), bands_(bands) {}
+        
+        void operator()(cv::Range const &range) const
+        {
+            typedef typename Storage::value_type T;
+            
+            for (int band = range.start; band < range.end; ++band)
+            {
+                int rowBegin = bands_.begin(band);
+                int rowEnd = bands_.end(band);
+                
+                T const *ubarBelow = (rowEnd < u_.rows ? bands_.ubarBelow<T>(band) : 0);
+                T const *p2Above = (rowBegin > 0 ? bands_.p2Above<T>(band) : 0);
+                
+                cds::PrimalDualRows<CN, Storage>(u_, ubar_, p1_, p2_, op_, dualProx_, prox_, tau_, sigma_, theta_,
+                                                 rowBegin, rowEnd, ubarBelow, p2Above);
+            }
+        }
+        
+    private:
+        cv::Mat &u_;
+        cv::Mat &ubar_;
+        cv::Mat &p1_;
+        cv::Mat &p2_;
+        Operator const &op_;
+        DualProx const &dualProx_;
+        PrimalProx const &prox_;
+        float tau_;
+        float sigma_;
+        float theta_;
+        PrimalDualBands &bands_;
+    };
+    
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualBlockRows(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator op, DualProx const &dualProx, PrimalProx prox,
+                             float tau, float sigma, float theta, int count, PrimalDualBands &bands, int band);
+    
+    /**
+     * First step of a block of iterations: copies the ghost rows of every band, before any band is updated
+     */
+    template <class Storage>
+    class PrimalDualGhosts : public cv::ParallelLoopBody
+    {
+    public:
+        PrimalDualGhosts(cv::Mat const &u, cv::Mat const &ubar, cv::Mat const &p1, cv::Mat const &p2, int count, PrimalDualBands &bands)
+        : u_(u), ubar_(ubar), p1_(p1), p2_(p2), count_(count), bands_(bands) {}
+        
+        void operator()(cv::Range const &range) const
+        {
+            typedef typename Storage::value_type T;
+            int const valuesPerRow = u_.cols * u_.channels();
+            int const K = bands_.blockDepth();
+            
+            for (int band = range.start; band < range.end; ++band)
+            {
+                int rowBegin = bands_.begin(band);
+                int rowEnd = bands_.end(band);
+                
+                int first = MAX(0, rowBegin - count_);
+                int last = MIN(u_.rows, rowEnd + count_ + 1);
+                
+                for (int y = first; y < last; ++y)
+                {
+                    if (y >= rowBegin && y < rowEnd)
+                    {
+                        continue;
+                    }
+                    
+                    int slot = (y < rowBegin ? y - rowBegin + K : y - rowEnd + K);
+                    
+                    std::copy(u_.ptr<float>(y), u_.ptr<float>(y) + valuesPerRow, bands_.ghostU(band, slot));
+                    std::copy(ubar_.ptr<T>(y), ubar_.ptr<T>(y) + valuesPerRow, bands_.ghostState<T>(band, 0, slot));
+                    std::copy(p1_.ptr<T>(y), p1_.ptr<T>(y) + valuesPerRow, bands_.ghostState<T>(band, 1, slot));
+                    std::copy(p2_.ptr<T>(y), p2_.ptr<T>(y) + valuesPerRow, bands_.ghostState<T>(band, 2, slot));
+                }
+            }
+        }
+        
+    private:
+        cv::Mat const &u_;
+        cv::Mat const &ubar_;
+        cv::Mat const &p1_;
+        cv::Mat const &p2_;
+        int count_;
+        PrimalDualBands &bands_;
+    };
+    
+    /**
+     * Second step of a block of iterations: advances every band by count iterations using its ghost rows
+     */
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    class PrimalDualBlock : public cv::ParallelLoopBody
+    {
+    public:
+        PrimalDualBlock(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                        PrimalProx const &prox, float tau, float sigma, float theta, int count, PrimalDualBands &bands)
+        : u_(u), ubar_(ubar), p1_(p1), p2_(p2), op_(op), dualProx_(dualProx), prox_(prox),
+          tau_(tau), sigma_(sigma), theta_(theta), count_(count), bands_(bands) {}
+        
+        void operator()(cv::Range const &range) const
+        {
+            for (int band = range.start; band < range.end; ++band)
+            {
+                cds::PrimalDualBlockRows<CN, Storage>(u_, ubar_, p1_, p2_, op_, dualProx_, prox_, tau_, sigma_, theta_, count_, bands_, band);
+            }
+        }
+        
+    private:
+        cv::Mat &u_;
+        cv::Mat &ubar_;
+        cv::Mat &p1_;
+        cv::Mat &p2_;
+        Operator const &op_;
+        DualProx const &dualProx_;
+        PrimalProx const &prox_;
+        float tau_;
+        float sigma_;
+        float theta_;
+        int count_;
+        PrimalDualBands &bands_;
+    };
+    
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualBandsIteration(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                                  PrimalProx const &prox, float tau, float sigma, float theta, PrimalDualBands &bands);
+    
+    template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualBandsBlock(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                              PrimalProx const &prox, float tau, float sigma, float theta, int count, PrimalDualBands &bands);
+    
+    template <class Storage, class Operator, class DualProx, class PrimalProx>
+    void PrimalDualStorageIterations(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                                     PrimalProx const &prox, float tau, float sigma, float theta, int count, PrimalDualBands &bands);
+    
+    /**
+     * One iteration of algorithms 1 and 2 in [1] (theta = 1 for algorithm 1):
+     *      p    <- dualProx(p + sigma*K(ubar))
+     *      u    <- prox(u + tau*K^T(p))
+     *      ubar <- u + theta*(u - u_old)
+     * u is a CV_32FC1 to CV_32FC4 image, ubar, p1 and p2 have the same number of channels and are
+     * stored as described by bands.storage(). The result does not depend on the number of bands.
+     */
+    template <class Operator, class DualProx, class PrimalProx>
+    void PrimalDualIteration(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                             PrimalProx const &prox, float tau, float sigma, float theta, PrimalDualBands &bands);
+    
+    /**
+     * Same as above for the isotropic TV
+     */
+    template <class PrimalProx>
+    void PrimalDualIteration(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, PrimalProx const &prox, float tau, float sigma, float theta,
+                             PrimalDualBands &bands)
+    {
+        cds::PrimalDualIteration(u, ubar, p1, p2, cds::TvOperator(), cds::ProjectionL2Ball(), prox, tau, sigma, theta, bands);
+    }
+    
+    /**
+     * count iterations with the same steps, with the same result as count calls to PrimalDualIteration.
+     * With bands.blockDepth() = K > 1, the iterations are run by blocks of K (temporal blocking): each
+     * band is swept once per block by a wavefront skewed by one row per iteration, which advances row y
+     * to iteration k+1 right after row y+1 reached iteration k. The rows being updated at a given time
+     * are then a window of about K rows, which stays in cache, so that each pixel is loaded from memory
+     * once per block instead of once per iteration. The bands read the rows of their neighbors from
+     * ghost copies taken at the start of the block, and update them redundantly (K^2 row updates per
+     * band boundary).
+     */
+    template <class Operator, class DualProx, class PrimalProx>
+    void PrimalDualIterations(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                              PrimalProx const &prox, float tau, float sigma, float theta, int count, PrimalDualBands &bands);
+    
+    /**
+     * Same as above for the isotropic TV
+     */
+    template <class PrimalProx>
+    void PrimalDualIterations(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, PrimalProx const &prox, float tau, float sigma, float theta,
+                              int count, PrimalDualBands &bands)
+    {
+        cds::PrimalDualIterations(u, ubar, p1, p2, cds::TvOperator(), cds::ProjectionL2Ball(), prox, tau, sigma, theta, count, bands);
+    }
+}
+
+/**
+ * Dual ascent + projection on one row, without updating the dual variable.
+ * Only p2 is kept, since this is what the row below needs for the divergence.
+ */
+template <int CN, class Storage, class Operator, class DualProx>
+void cds::DualRow(cv::Mat const &ubar, cv::Mat const &p1, cv::Mat const &p2, Operator op, DualProx const &dualProx, float sigma, int y,
+                  typename Storage::value_type *p2Out)
+{
+    typedef typename Storage::value_type T;
+    int const cols = ubar.cols;
+    
+    T const *p_ubar = ubar.ptr<T>(y);
+    T const *p_ubar_next = (y+1 < ubar.rows ? ubar.ptr<T>(y+1) : p_ubar);
+    T const *p_p1 = p1.ptr<T>(y);
+    T const *p_p2 = p2.ptr<T>(y);
+    float const hasNextRow = (y+1 < ubar.rows ? 1.0f : 0.0f);
+    
+    op.setRow(y);
+    
+    for (int x = 0; x < cols; ++x, p_ubar += CN, p_ubar_next += CN, p_p1 += CN, p_p2 += CN, p2Out += CN)
+    {
+        bool const hasNextCol = (x+1 < cols);
+        float const sigmaW = sigma * op.weight(x) * op.sigmaScale(x);
+        
+        float q1[CN];
+        float q2[CN];
+        
+        for (int c = 0; c < CN; ++c)
+        {
+            float ubar_x = Storage::load(p_ubar[c]);
+            
+            q1[c] = (hasNextCol ? Storage::load(p_p1[c]) + sigmaW * (Storage::load(p_ubar[c+CN]) - ubar_x) : 0.0f);
+            q2[c] = hasNextRow * (Storage::load(p_p2[c]) + sigmaW * (Storage::load(p_ubar_next[c]) - ubar_x));
+        }
+        
+        dualProx.template project<CN>(q1, q2, sigma);
+        
+        for (int c = 0; c < CN; ++c)
+        {
+            p2Out[c] = Storage::store(hasNextRow * q2[c]);
+        }
+    }
+}
+
+/**
+ * One iteration of the engine, fused in a single sweep over the rows [rowBegin, rowEnd).
+ * The update of row y only needs the old ubar on rows y and y+1 and the new p2 on row y-1, so
+ * everything is done in place and u_old never needs to be stored.
+ * When the rows are a band of a larger frame, ubarBelow and p2Above hold the halo rows
+ * (old ubar on row rowEnd, new p2 on row rowBegin-1), otherwise they are null.
+ */
+template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualRows(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator op, DualProx const &dualProx, PrimalProx prox,
+                         float tau, float sigma, float theta,
+                         int rowBegin, int rowEnd, typename Storage::value_type const *ubarBelow, typename Storage::value_type const *p2Above)
+{
+    typedef typename Storage::value_type T;
+    int const rows = u.rows;
+    
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        T *p_ubar = ubar.ptr<T>(y);
+        T *p_p2 = p2.ptr<T>(y);
+        
+        // p2 is 0 above the first row
+        T const *p_ubar_next = (y+1 < rows ? ubar.ptr<T>(y+1) : p_ubar);
+        T const *p_p2_prev = (y > 0 ? p2.ptr<T>(y-1) : p_p2);
+        
+        if (y+1 == rowEnd && ubarBelow)
+        {
+            p_ubar_next = ubarBelow;
+        }
+        
+        if (y == rowBegin && p2Above)
+        {
+            p_p2_prev = p2Above;
+        }
+        
+        cds::PrimalDualRow<CN, Storage>(u.ptr<float>(y), p_ubar, p1.ptr<T>(y), p_p2, p_ubar_next, p_p2_prev, y, rows, u.cols,
+                                        op, dualProx, prox, tau, sigma, theta);
+    }
+}
+
+/**
+ * Update of row y by the fused sweep, given the rows it reads: the old ubar on row y+1 and the
+ * new p2 on row y-1 (ignored on the first and last rows of the frame).
+ * The gradient uses the forward scheme and the divergence the backward one (adjoint of the gradient),
+ * like HorizontalGradientWithForwardScheme/VerticalGradientWithForwardScheme and DivergenceWithBackwardScheme.
+ * With CN > 1 channels, the dual prox sees all the channels of a pixel at once (vectorial TV).
+ * ubar and p are stored as Storage::value_type (u is always float32), the divergence uses the
+ * stored (rounded) values of p so that it stays the adjoint of the gradient of what is stored.
+ */
+template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualRow(float *p_u, typename Storage::value_type *p_ubar, typename Storage::value_type *p_p1, typename Storage::value_type *p_p2,
+                        typename Storage::value_type const *p_ubar_next, typename Storage::value_type const *p_p2_prev, int y, int rows, int cols,
+                        Operator &op, DualProx const &dualProx, PrimalProx &prox, float tau, float sigma, float theta)
+{
+    // p2 vanishes on the last row
+    float const hasNextRow = (y+1 < rows ? 1.0f : 0.0f);
+    float const hasPrevRow = (y > 0 ? 1.0f : 0.0f);
+    
+    op.setRow(y);
+    prox.setRow(y);
+    
+    // K^T p needs the weighted p1 of the previous pixel
+    float wp1_prev[CN] = {0.0f};
+    
+    for (int x = 0; x < cols; ++x)
+    {
+        int const i = x * CN;
+        
+        // Dual ascent + prox, p1 vanishes on the last column
+        bool const hasNextCol = (x+1 < cols);
+        float const w = op.weight(x);
+        float const wAbove = hasPrevRow * op.weightAbove(x);
+        float const sigmaW = sigma * w * op.sigmaScale(x);
+        float const tauX = tau * op.tauScale(x);
+        
+        float q1[CN];
+        float q2[CN];
+        
+        for (int c = 0; c < CN; ++c)
+        {
+            float ubar_x = Storage::load(p_ubar[i+c]);
+            
+            q1[c] = (hasNextCol ? Storage::load(p_p1[i+c]) + sigmaW * (Storage::load(p_ubar[i+c+CN]) - ubar_x) : 0.0f);
+            q2[c] = hasNextRow * (Storage::load(p_p2[i+c]) + sigmaW * (Storage::load(p_ubar_next[i+c]) - ubar_x));
+        }
+        
+        dualProx.template project<CN>(q1, q2, sigma);
+        
+        for (int c = 0; c < CN; ++c)
+        {
+            p_p1[i+c] = Storage::store(hasNextCol ? q1[c] : 0.0f);
+            p_p2[i+c] = Storage::store(hasNextRow * q2[c]);
+            
+            float wp1 = w * Storage::load(p_p1[i+c]);
+            float wp2 = w * Storage::load(p_p2[i+c]);
+            
+            // Divergence with the backward scheme
+            float divP = (wp1 - wp1_prev[c]) + (wp2 - wAbove * Storage::load(p_p2_prev[i+c]));
+            wp1_prev[c] = wp1;
+            
+            // Primal descent + over-relaxation
+            float u_old = p_u[i+c];
+            float u_new = prox(u_old + tauX * divP, x, i+c);
+            
+            p_u[i+c] = u_new;
+            p_ubar[i+c] = Storage::store(u_new + theta * (u_new - u_old));
+        }
+    }
+}
+
+template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualBandsIteration(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                                   PrimalProx const &prox, float tau, float sigma, float theta, cds::PrimalDualBands &bands)
+{
+    if (bands.size() == 1)
+    {
+        cds::PrimalDualRows<CN, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, 0, u.rows, 0, 0);
+        return;
+    }
+    
+    // Halo exchange, then update of all the bands
+    cv::parallel_for_(cv::Range(0, bands.size()),
+                      cds::PrimalDualHalos<CN, Storage, Operator, DualProx>(ubar, p1, p2, op, dualProx, sigma, bands));
+    cv::parallel_for_(cv::Range(0, bands.size()),
+                      cds::PrimalDualSweep<CN, Storage, Operator, DualProx, PrimalProx>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, bands));
+}
+
+/**
+ * count iterations of the rows of a band, and of the ghost rows around it, by a skewed wavefront.
+ * The K rows above the band are only partly right: their new p2 only depends on rows below them,
+ * but their u needs the new p2 of the row above them, which is wrong on the topmost one. The wrong
+ * rows grow by one per iteration, so iteration k starts k rows lower, and the K ghost rows absorb
+ * them. Likewise, iteration k ends k rows higher below the band, where the old ubar of the next
+ * row is not known after the first iteration.
+ */
+template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualBlockRows(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator op, DualProx const &dualProx, PrimalProx prox,
+                              float tau, float sigma, float theta, int count, cds::PrimalDualBands &bands, int band)
+{
+    typedef typename Storage::value_type T;
+    int const rows = u.rows;
+    int const K = bands.blockDepth();
+    int const rowBegin = bands.begin(band);
+    int const rowEnd = bands.end(band);
+    
+    int const top = MAX(0, rowBegin - count);
+    int const bottom = MIN(rows, rowEnd + count);
+    
+    for (int step = top; step < bottom + count - 1; ++step)
+    {
+        // Iteration k on row step-k, after iteration k-1 on row step-k+1
+        for (int k = 0; k < count; ++k)
+        {
+            int y = step - k;
+            int first = (rowBegin == 0 ? 0 : MAX(0, rowBegin - count + k));
+            int last = (rowEnd == rows ? rows : MIN(rows, rowEnd + count - k));
+            
+            if (y < first || y >= last)
+            {
+                continue;
+            }
+            
+            float *p_u;
+            T *p_ubar, *p_p1, *p_p2;
+            T const *p_ubar_next, *p_p2_prev;
+            
+            if (y >= rowBegin && y < rowEnd)
+            {
+                p_u = u.ptr<float>(y);
+                p_ubar = ubar.ptr<T>(y);
+                p_p1 = p1.ptr<T>(y);
+                p_p2 = p2.ptr<T>(y);
+            }
+            else
+            {
+                int slot = (y < rowBegin ? y - rowBegin + K : y - rowEnd + K);
+                p_u = bands.ghostU(band, slot);
+                p_ubar = bands.ghostState<T>(band, 0, slot);
+                p_p1 = bands.ghostState<T>(band, 1, slot);
+                p_p2 = bands.ghostState<T>(band, 2, slot);
+            }
+            
+            if (y+1 >= rows)
+            {
+                p_ubar_next = p_ubar;
+            }
+            else if (y+1 >= rowBegin && y+1 < rowEnd)
+            {
+                p_ubar_next = ubar.ptr<T>(y+1);
+            }
+            else
+            {
+                p_ubar_next = bands.ghostState<T>(band, 0, (y+1 < rowBegin ? y+1 - rowBegin + K : y+1 - rowEnd + K));
+            }
+            
+            // p2 is 0 above the first row, and the topmost row of the iteration is wrong anyway
+            if (y == 0 || y == first)
+            {
+                p_p2_prev = p_p2;
+            }
+            else if (y-1 >= rowBegin && y-1 < rowEnd)
+            {
+                p_p2_prev = p2.ptr<T>(y-1);
+            }
+            else
+            {
+                p_p2_prev = bands.ghostState<T>(band, 2, (y-1 < rowBegin ? y-1 - rowBegin + K : y-1 - rowEnd + K));
+            }
+            
+            cds::PrimalDualRow<CN, Storage>(p_u, p_ubar, p_p1, p_p2, p_ubar_next, p_p2_prev, y, rows, u.cols,
+                                            op, dualProx, prox, tau, sigma, theta);
+        }
+    }
+}
+
+template <int CN, class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualBandsBlock(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                               PrimalProx const &prox, float tau, float sigma, float theta, int count, cds::PrimalDualBands &bands)
+{
+    if (count == 1)
+    {
+        cds::PrimalDualBandsIteration<CN, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, bands);
+        return;
+    }
+    
+    if (bands.size() == 1)
+    {
+        cds::PrimalDualBlockRows<CN, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, count, bands, 0);
+        return;
+    }
+    
+    // Ghost rows, then update of all the bands
+    cv::parallel_for_(cv::Range(0, bands.size()), cds::PrimalDualGhosts<Storage>(u, ubar, p1, p2, count, bands));
+    cv::parallel_for_(cv::Range(0, bands.size()),
+                      cds::PrimalDualBlock<CN, Storage, Operator, DualProx, PrimalProx>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, count, bands));
+}
+
+template <class Storage, class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualStorageIterations(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                                      PrimalProx const &prox, float tau, float sigma, float theta, int count, cds::PrimalDualBands &bands)
+{
+    for (int done = 0; done < count; done += bands.blockDepth())
+    {
+        int blockCount = MIN(bands.blockDepth(), count - done);
+        
+        switch (u.channels())
+        {
+            case 1:
+                cds::PrimalDualBandsBlock<1, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, blockCount, bands);
+                break;
+            case 2:
+                cds::PrimalDualBandsBlock<2, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, blockCount, bands);
+                break;
+            case 3:
+                cds::PrimalDualBandsBlock<3, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, blockCount, bands);
+                break;
+            case 4:
+                cds::PrimalDualBandsBlock<4, Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, blockCount, bands);
+                break;
+            default:
+                CV_Error(CV_StsUnsupportedFormat, "TV solvers handle 1 to 4 channels");
+        }
+    }
+}
+
+template <class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualIterations(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                               PrimalProx const &prox, float tau, float sigma, float theta, int count, cds::PrimalDualBands &bands)
+{
+    switch (bands.storage())
+    {
+        case TV_STORAGE_FLOAT16:
+            cds::PrimalDualStorageIterations<cds::Float16Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, count, bands);
+            break;
+        case TV_STORAGE_BFLOAT16:
+            cds::PrimalDualStorageIterations<cds::BFloat16Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, count, bands);
+            break;
+        default:
+            cds::PrimalDualStorageIterations<cds::Float32Storage>(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, count, bands);
+    }
+}
+
+template <class Operator, class DualProx, class PrimalProx>
+void cds::PrimalDualIteration(cv::Mat &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, Operator const &op, DualProx const &dualProx,
+                              PrimalProx const &prox, float tau, float sigma, float theta, cds::PrimalDualBands &bands)
+{
+    cds::PrimalDualIterations(u, ubar, p1, p2, op, dualProx, prox, tau, sigma, theta, 1, bands);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// REFERENCES:																					//
+//																								//
+// [1] Chambolle, A., Pock, T. (2010).	 														//
+//     A First-Order Primal-Dual Algorithm for Convex Problems with Applications to Imaging. 	//
+//     Journal of Mathematical Imaging and Vision, 40(1), 120–145.								//
+//																								//
+// [2] Pock, T., Chambolle, A. (2011).															//
+//     Diagonal preconditioning for first order primal-dual algorithms in convex optimization.	//
+//     IEEE International Conference on Computer Vision (ICCV), 1762–1769.						//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif	// CDS_PRIMALDUALENGINE_HPP
@@ -0,0 +1,102 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_SPATIOTEMPORAL_HPP
+#define CDS_SPATIOTEMPORAL_HPP
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace cds
+{
+  /**
+   * Streaming Rudin-Osher-Fatemi denoising of a video, with a spatio-temporal Total Variation:
+   * 		min 0.5*lambda*|u-g|^2 + TV(u)
+   * where TV(u) = sqrt(|ux|^2 + |uy|^2 + (w*ut)^2) is taken over the last K frames, ut being
+   * the forward difference between consecutive frames.
+   * The problem is solved with the primal-dual scheme in [1] on a ring buffer of K frames: each
+   * new frame replaces the oldest one, the other frames keep their primal and dual variables as
+   * a warm start, and the denoised version of the new frame is returned. The output is causal,
+   * i.e. the new frame only sees the past frames of the window.
+   * The memory used is bounded by 6*K frames, whatever the length of the video.
+   *
+   * Usage:
+   * 		cds::SpatioTemporalTvDiffusion denoiser(5, 20, 10.0f);
+   * 		while (video >> frame) { denoiser(frame32, u); ... }
+   */
+  class SpatioTemporalTvDiffusion
+  {
+  public:
+    /**
+     * @param windowSize The number K of frames in the sliding window (3-7 are good values)
+     * @param iterations The number of iterations run on the window for each new frame (10-30 are good values)
+     * @param lambda Weight of the data term
+     * @param temporalWeight Weight w of the temporal derivative with respect to the spatial ones
+     */
+    SpatioTemporalTvDiffusion(int windowSize, int iterations, float lambda, float temporalWeight = 1.0f);
+    
+    /**
+     * Adds a frame to the window and denoises it.
+     * The window is emptied when the size or the type of the frames changes.
+     * @param frame The new frame, of type CV_32FC1 to CV_32FC4
+     * @param u The denoised frame, of the same type as frame
+     */
+    void operator()(cv::Mat const &frame, cv::Mat &u);
+    
+    /**
+     * Empties the window, e.g. on a scene cut
+     */
+    void reset();
+    
+    int windowSize() const { return windowSize_; }
+    
+  private:
+    void iterate(float tau, float sigma);
+    
+    int windowSize_;
+    int iterations_;
+    float lambda_;
+    float temporalWeight_;
+    
+    // Ring buffer: the frames of the window are slots (oldest_ + t) % windowSize_, t = 0..count_-1
+    int oldest_;
+    int count_;
+    
+    std::vector<cv::Mat> g_;
+    std::vector<cv::Mat> u_;
+    std::vector<cv::Mat> ubar_;
+    std::vector<cv::Mat> p1_;
+    std::vector<cv::Mat> p2_;
+    std::vector<cv::Mat> p3_;
+  };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// REFERENCES:																					//
+//																								//
+// [1] Chambolle, A., Pock, T. (2010).	 														//
+//     A First-Order Primal-Dual Algorithm for Convex Problems with Applications to Imaging. 	//
+//     Journal of Mathematical Imaging and Vision, 40(1), 120–145.								//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif	// CDS_SPATIOTEMPORAL_HPP
@@ -25,5 +25,14 @@
 #define CDS_TV_HPP
 
 #include "primaldual.hpp"
+#include "spatiotemporal.hpp"
+#include "primaldualengine.hpp"
+#include "tvsolver.hpp"
+#include "tvasync.hpp"
+#include "splitbregman.hpp"
+#include "anisotropic.hpp"
+#include "deblurring.hpp"
+#include "tvstream.hpp"
+#include "nonlocal.hpp"
 
 #endif  // CDS_TV_HPP
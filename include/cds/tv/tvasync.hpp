@@ -0,0 +1,181 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_TVASYNC_HPP
+#define CDS_TVASYNC_HPP
+
+#include <cds/tv/tvsolver.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+#include <pthread.h>
+
+namespace cds
+{
+  /**
+   * Handle on a TV solve (TvDiffusion or TvInpainting) running on its own thread, so that the
+   * solver can be used as an anytime algorithm with a bounded latency, e.g. in an interactive tool:
+   * the solve can be cancelled, stopped on a wall-clock deadline with the current iterate as result,
+   * and it can publish snapshots of u while it runs.
+   *
+   * Usage:
+   * 		cds::TvSolveTask task;
+   * 		task.setDeadline(0.05);
+   * 		task.setSnapshots(10);
+   * 		task.startInpainting(g, mask, 1000);
+   * 		...
+   * 		if (task.snapshot(preview)) display(preview);	// From any thread
+   * 		...
+   * 		task.cancel();									// e.g. when the brush moves
+   * 		task.result(u);
+   *
+   * The start functions, result and the destructor belong to the thread that owns the task,
+   * cancel, wait, done, failed, error, iteration and snapshot can be called from any thread.
+   */
+  class TvSolveTask
+  {
+  public:
+    TvSolveTask();
+    
+    /**
+     * Cancels the running solve and waits for it
+     */
+    ~TvSolveTask();
+    
+    /**
+     * Starts TvDiffusion(g, u, iterations, lambda) in the background, after cancelling the running solve.
+     * The images are copied, so they can be modified while the task runs.
+     * @param u0 The initial iterate (e.g. the result for a previous version of g), or an empty matrix
+     */
+    void startDiffusion(cv::Mat const &g, int iterations, float lambda, cv::Mat const &u0 = cv::Mat());
+    
+    /**
+     * Same as startDiffusion for TvInpainting(g, mask, u, iterations)
+     */
+    void startInpainting(cv::Mat const &g, cv::Mat const &mask, int iterations, cv::Mat const &u0 = cv::Mat());
+    
+    /**
+     * Wall-clock budget of the next solves in seconds, from their start (0 means no deadline)
+     */
+    void setDeadline(double seconds) { deadline_ = seconds; }
+    
+    /**
+     * Copies u every `every` iterations while the next solves run, see snapshot (0 means no snapshots)
+     */
+    void setSnapshots(int every) { snapshotEvery_ = every; }
+    
+    /**
+     * The solver, e.g. to choose its storage, its temporal blocking or its stopping tolerance.
+     * It must not be used while a solve runs.
+     */
+    TvSolver &solver() { return solver_; }
+    
+    /**
+     * Asks the running solve to stop after its current iteration, returns immediately
+     */
+    void cancel();
+    
+    /**
+     * Waits for the end of the solve, for at most `seconds` if it is nonnegative
+     * @return true if the solve is over
+     */
+    bool wait(double seconds = -1.0);
+    
+    bool done();
+    
+    /**
+     * True if the last solve was stopped by cancel or by the deadline before its last iteration
+     */
+    bool interrupted();
+    
+    /**
+     * Number of iterations done by the last solve so far
+     */
+    int iteration();
+    
+    /**
+     * Copies the last snapshot of u
+     * @return false if there is no snapshot yet
+     */
+    bool snapshot(cv::Mat &u);
+    
+    /**
+     * True if the last solve stopped on an error (see error), in which case it has no result
+     */
+    bool failed();
+    
+    /**
+     * Message of the error of the last solve, empty if it did not fail
+     */
+    std::string error();
+    
+    /**
+     * Waits for the end of the solve and copies its result
+     * @return false, leaving u untouched, if the solve failed
+     */
+    bool result(cv::Mat &u);
+    
+  private:
+    // Not copyable, the thread works on the members
+    TvSolveTask(TvSolveTask const &);
+    TvSolveTask &operator=(TvSolveTask const &);
+    
+    void start(cv::Mat const &g, cv::Mat const &mask, int iterations, float lambda, cv::Mat const &u0);
+    void run();
+    void join();
+    
+    static void *Run(void *task);
+    static bool Interrupt(int iteration, cv::Mat const &u, void *task);
+    
+    TvSolver solver_;
+    double deadline_;
+    int snapshotEvery_;
+    
+    // Inputs and iterate, only used by the thread while it runs
+    cv::Mat g_;
+    cv::Mat mask_;
+    cv::Mat u_;
+    int iterations_;
+    float lambda_;
+    int64 deadlineTicks_;	// 0 if there is no deadline
+    int snapshotPeriod_;
+    int lastSnapshot_;	// Iteration of the last snapshot
+    
+    // Shared with the thread, under mutex_
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t finished_;
+    bool running_;
+    bool joined_;
+    bool cancelled_;
+    bool interrupted_;
+    bool failed_;
+    std::string error_;
+    int iteration_;
+    cv::Mat snapshot_;
+  };
+}
+
+#endif	// CDS_TVASYNC_HPP
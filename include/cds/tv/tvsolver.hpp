@@ -0,0 +1,369 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CDS_TVSOLVER_HPP
+#define CDS_TVSOLVER_HPP
+
+#include <cds/tv/primaldualengine.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+namespace cds
+{
+  /**
+   * Convergence measures of TvSolver, see TvSolver::setStopping.
+   * The gap is the difference between the primal energy of u and the dual energy of p: it is
+   * nonnegative and bounds the distance of the primal energy to the optimum.
+   */
+  struct TvStats
+  {
+    int iteration;
+    double primalEnergy;
+    double dualEnergy;
+    double gap;
+    double relativeGap;	// gap / |primal energy|
+  };
+  
+  /**
+   * Called by TvSolver each time the energies are measured, returning false stops the solver
+   */
+  typedef bool (*TvStatsCallback)(TvStats const &stats, void *userData);
+  
+  /**
+   * Called by TvSolver after each block of iterations with the current iterate, returning true
+   * interrupts the solver (see TvSolver::setInterruptCallback)
+   */
+  typedef bool (*TvInterruptCallback)(int iteration, cv::Mat const &u, void *userData);
+  
+  /**
+   * Called by TvSolver::solvePath with the solution for each value of lambda
+   */
+  typedef void (*TvPathCallback)(int index, float lambda, cv::Mat const &u, void *userData);
+  
+  /**
+   * Workspace of the primal-dual TV solvers of primaldual.hpp, sized once for a frame geometry.
+   * The auxiliary point, the dual variable and the halos of the parallel bands are owned by the
+   * solver, so that solving a stream of frames of the same size and type performs no heap
+   * allocation once the first frame is done (as long as u is kept from one call to the next).
+   * With the default float32 storage, the results are the same as the ones of the corresponding
+   * free functions.
+   *
+   * Usage:
+   * 		cds::TvSolver solver(frameSize, CV_32FC1);
+   * 		for each frame: solver.solve(frame, u, 50, 10.0f);
+   *
+   * The ROF (TvDiffusion, TvDiffusionAccelerated) and inpainting solvers can stop before the given
+   * number of iterations, which becomes a maximum, when the relative primal-dual gap falls below a
+   * tolerance:
+   * 		solver.setStopping(1e-4, 10);
+   * 		solver.solve(g, mask, u, 1000);
+   * 		std::cout << solver.stats().iteration << " iterations" << std::endl;
+   *
+   * Long runs can be checkpointed and resumed after an interruption, with the same result as an
+   * uninterrupted run:
+   * 		solver.setCheckpoint("scan.tvck", 100);
+   * 		solver.load("scan.tvck", u);		// Fails (and does nothing) on the first run
+   * 		solver.solve(g, mask, u, 5000);		// solver.resumed() tells whether the checkpoint was used
+   */
+  class TvSolver
+  {
+  public:
+    TvSolver();
+    
+    /**
+     * @param frameSize The size of the frames
+     * @param type The type of the frames, CV_32FC1 to CV_32FC4
+     * @param storage The storage of the state of the solver, see TvStorage
+     */
+    TvSolver(cv::Size frameSize, int type, int storage = TV_STORAGE_FLOAT32);
+    
+    ~TvSolver();
+    
+    /**
+     * Allocates the workspace, does nothing if it already has the right size and type
+     */
+    void create(cv::Size frameSize, int type, int storage = TV_STORAGE_FLOAT32);
+    
+    cv::Size size() const { return frameSize_; }
+    int type() const { return type_; }
+    int storage() const { return storage_; }
+    
+    /**
+     * Measures the energies every checkEvery iterations, and stops when the relative gap is below
+     * relativeGap (0 disables the stopping test).
+     * A measure costs about one iteration, and nothing is measured if there is no tolerance nor callback.
+     */
+    void setStopping(double relativeGap, int checkEvery = 10);
+    
+    /**
+     * Sets a function called with the stats of each measure, e.g. for convergence plots
+     */
+    void setStatsCallback(TvStatsCallback callback, void *userData = 0);
+    
+    /**
+     * Sets a function called after every iteration (every block with temporal blocking), which can
+     * interrupt the solve, leaving the current iterate in u: e.g. to cancel it, or to stop it on a
+     * deadline. Unlike the stats callback, it does not measure the energies, so it costs nothing.
+     * @param every If positive, the blocks also end on the multiples of this number of iterations,
+     *              so that the callback sees them (e.g. for snapshots of u)
+     */
+    void setInterruptCallback(TvInterruptCallback callback, void *userData = 0, int every = 0);
+    
+    /**
+     * Last measure of the energies, iteration is the number of iterations done by the last solve
+     */
+    TvStats const &stats() const { return stats_; }
+    
+    /**
+     * Saves the state every `every` iterations of the solves to filename (0 disables).
+     * The file is replaced atomically, so an interruption while saving keeps the previous checkpoint.
+     */
+    void setCheckpoint(std::string const &filename, int every);
+    
+    /**
+     * True if a checkpoint of the last solve could not be written (the solve itself goes on)
+     */
+    bool checkpointFailed() const { return checkpointFailed_; }
+    
+    /**
+     * Writes u and the state of the solver (auxiliary point, dual variable, parameters, steps and
+     * iteration index of the current solve) to a flat binary file: a 64-byte header followed by the planes of
+     * u, ubar, p1 and p2 stored row after row, in the byte order of the machine.
+     * The file is flushed to the disk before it replaces the previous one (POSIX only).
+     * @return false if the file could not be written
+     */
+    bool save(std::string const &filename, cv::Mat const &u) const;
+    
+    /**
+     * Restores a state written by save, by memory-mapping the file (POSIX only), with its frame
+     * geometry. The next solve of the same problem (same kind of solve and same lambda) continues
+     * from it instead of starting over, up to the same total number of iterations; any other solve
+     * starts over from the restored u, which resumed() tells. The solves with policies cannot be
+     * resumed, since their operator and prox are not known to the checkpoint.
+     * @return false, leaving the solver and u untouched, if the file is missing or invalid, if it was
+     *         written by a solve with policies, or with another storage or preconditioning than the
+     *         ones of this solver (the temporal blocking may differ)
+     */
+    bool load(std::string const &filename, cv::Mat &u);
+    
+    /**
+     * True if the last solve continued the state restored by load, false if it started over
+     */
+    bool resumed() const { return resumed_; }
+    
+    /**
+     * Runs the iterations by blocks of up to `iterations` at once (temporal blocking, see
+     * PrimalDualIterations), with the same results. This pays off for frames much larger than the
+     * caches, with blocks of 4 to 16 iterations. The accelerated solver, whose steps change at every
+     * iteration, is not blocked.
+     */
+    void setTemporalBlocking(int iterations);
+    int temporalBlocking() const { return blockDepth_; }
+    
+    /**
+     * Makes the next solve of the same problem (same kind of solve, on frames of the same size and
+     * type) continue from the current state, u, the auxiliary point and the dual variable, instead
+     * of restarting from u and grad(u). This is for streams of similar frames, such as videos (see
+     * TvDiffusionStream), where the state reached on a frame is a good start for the next one.
+     * The steps and the stats of the solve restart.
+     */
+    void keepState() { warmStart_ = true; }
+    
+    /**
+     * Restarts the state of the last solve on a region, e.g. after a scene cut in a part of a
+     * video: u = g there, and the auxiliary point and the dual variable are the ones of a solve
+     * starting from it. The rest of the state is kept.
+     * @param g A frame of the size and type of the last solve
+     * @param u The current solution
+     */
+    void restart(cv::Mat const &g, cv::Mat &u, cv::Rect const &region);
+    
+    /**
+     * Uses the diagonal preconditioning of Pock and Chambolle (PreconditionedTvOperator) in the
+     * inpainting solve: each pixel and each edge gets its own step from the number of free pixels
+     * around it, so that the steps are larger on the holes, where the known pixels do not constrain
+     * the operator.
+     * The cost of an iteration is unchanged and the iterate gets closer to the solution, by about
+     * 1.5 times on masks hiding 50 to 97% of the pixels.
+     */
+    void setPreconditioning(bool enabled) { preconditioning_ = enabled; }
+    bool preconditioning() const { return preconditioning_; }
+    
+    /**
+     * Starts the inpainting solve from the harmonic inpainting of g (HarmonicInpainting, a few
+     * multigrid cycles) instead of 0 when u is not given, so that the iterations do not have to
+     * propagate the mean intensity into the holes.
+     */
+    void setHarmonicStart(bool enabled) { harmonicStart_ = enabled; }
+    bool harmonicStart() const { return harmonicStart_; }
+    
+    /**
+     * Same as TvDiffusion
+     */
+    void solve(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+    
+    /**
+     * Same as TvDiffusionAccelerated
+     */
+    void solveAccelerated(cv::Mat const &g, cv::Mat &u, int iterations, float lambda);
+    
+    /**
+     * Solves the ROF problem of solveAccelerated for each value of lambda in turn (regularisation path),
+     * each solve starting from the primal and dual state of the previous one (warm start), with fresh
+     * steps. The solutions for neighboring values are close, so 1.5 to 2 times fewer iterations give the
+     * same accuracy as from scratch. With a stopping tolerance (setStopping), iterations is a maximum
+     * per value.
+     * @param lambdas The values of lambda, sorted (increasing or decreasing) so that they are neighbors
+     * @param u The solution for the last value. If it matches g, it is the starting point of the first one.
+     * @param callback Called with each solution as soon as it is known (may be null)
+     */
+    void solvePath(cv::Mat const &g, std::vector<float> const &lambdas, cv::Mat &u, int iterations,
+                   TvPathCallback callback, void *userData = 0);
+    
+    /**
+     * Same as TvInpainting
+     */
+    void solve(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations);
+    
+    /**
+     * Runs algorithm 1 of [1] with the policies of primaldualengine.hpp, e.g. for Huber-TV-L1:
+     * 		solver.solve(g, u, 200, cds::TvOperator(), cds::HuberProjection(0.05f), cds::ProxL1Pixel(g, 1.0f, 0.0f));
+     * The steps are derived from op.normSquared() and given to the primal prox with setTau.
+     * The energies are not known for arbitrary policies, so this always runs all the iterations.
+     * @param g The observed image, it only gives the size and type of u
+     */
+    template <class Operator, class DualProx, class PrimalProx>
+    void solve(cv::Mat const &g, cv::Mat &u, int iterations, Operator const &op, DualProx const &dualProx, PrimalProx const &prox);
+    
+  private:
+    // Not copyable, the bands are owned
+    TvSolver(TvSolver const &);
+    TvSolver &operator=(TvSolver const &);
+    
+    // Kind of the current solve, recorded in the checkpoints
+    enum Problem { PROBLEM_ROF = 0, PROBLEM_ROF_ACCELERATED = 1, PROBLEM_INPAINTING = 2, PROBLEM_GENERIC = 3,
+                   PROBLEM_INPAINTING_PRECONDITIONED = 4 };
+    
+    /**
+     * Starts a solve, or resumes the state restored by load: returns true in the latter case, where
+     * the steps and the iteration index are the ones of the checkpoint.
+     * @param lambda The parameter of the problem (0 if it has none), checked against the checkpoint
+     */
+    bool start(cv::Mat const &g, cv::Mat &u, int problem, float lambda);
+    
+    /**
+     * Saves the state if a checkpoint is due at the current iteration
+     */
+    void checkpoint(cv::Mat const &u);
+    
+    /**
+     * Asks the interrupt callback whether to stop
+     */
+    bool interrupted(cv::Mat const &u) { return interrupt_ && interrupt_(stats_.iteration, u, interruptData_); }
+    
+    /**
+     * Counts the last iterations, measures the energies when it is time to and tells whether to stop.
+     * An empty mask means the ROF model with parameter lambda, otherwise inpainting.
+     */
+    bool monitor(cv::Mat const &g, cv::Mat const &mask, cv::Mat const &u, float lambda, int count);
+    
+    /**
+     * Number of iterations of the next block, which ends at the latest on the next measure, checkpoint or
+     * multiple of the period of the interrupt callback
+     */
+    int blockLength(int iterations) const;
+    
+    cv::Size frameSize_;
+    int type_;
+    int storage_;
+    
+    cv::Mat ubar_;
+    cv::Mat p1_;
+    cv::Mat p2_;
+    PrimalDualBands *bands_;
+    
+    double tolerance_;
+    int checkEvery_;
+    TvStatsCallback callback_;
+    void *userData_;
+    TvInterruptCallback interrupt_;
+    void *interruptData_;
+    int interruptEvery_;
+    TvStats stats_;
+    cv::Mat sums_;	// Partial sums of the energies, one row per image row
+    
+    int problem_;
+    float lambda_;
+    float tau_;
+    float sigma_;
+    bool resume_;
+    bool resumed_;	// The last solve continued a loaded checkpoint
+    std::string checkpointFile_;
+    int checkpointEvery_;
+    bool checkpointFailed_;
+    int blockDepth_;
+    bool warmStart_;	// The next solve keeps u, ubar and p, see solvePath
+    bool preconditioning_;
+    bool harmonicStart_;
+  };
+}
+
+template <class Operator, class DualProx, class PrimalProx>
+void cds::TvSolver::solve(cv::Mat const &g, cv::Mat &u, int iterations, Operator const &op, DualProx const &dualProx, PrimalProx const &prox)
+{
+    if (!g.data)
+    {
+        return;
+    }
+    
+    start(g, u, PROBLEM_GENERIC, 0.0f);
+    
+    // Numerical parameters
+    float L2 = op.normSquared();
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    tau_ = tau;
+    sigma_ = sigma;
+    
+    PrimalProx primalProx(prox);
+    primalProx.setTau(tau);
+    
+    while (stats_.iteration < iterations)
+    {
+        int count = blockLength(iterations);
+        cds::PrimalDualIterations(u, ubar_, p1_, p2_, op, dualProx, primalProx, tau, sigma, 1.0f, count, *bands_);
+        
+        stats_.iteration += count;
+        checkpoint(u);
+        
+        if (interrupted(u))
+        {
+            break;
+        }
+    }
+}
+
+#endif	// CDS_TVSOLVER_HPP
@@ -0,0 +1,529 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/inpainting/exemplar.hpp>
+#include <cds/tv/primaldual.hpp>
+#include <cds/tools/masking.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// Height of the bands of rows propagated in parallel
+#define EXEMPLAR_BAND_HEIGHT 16
+// Number of PatchMatch passes (alternating scan orders) between two votes
+#define EXEMPLAR_PATCHMATCH_PASSES 2
+// Percentile of the patch distances used as the scale of the voting weights
+#define EXEMPLAR_WEIGHT_PERCENTILE 0.75
+
+namespace cds
+{
+    /**
+     * Sets u to g on the known pixels
+     */
+    void CopyKnownPixels(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u);
+    
+    /**
+     * Mean squared difference between the patches of u centered on p and q, over the pixels of the
+     * patch of p that are inside the image (the patch of q must be inside the image).
+     * The computation stops as soon as the distance exceeds the bound.
+     */
+    float PatchDistance(cv::Mat const &u, cv::Point p, cv::Point q, int radius, float bound);
+    
+    /**
+     * Completion of one level of the pyramid: the field (CV_32SC2, the center of the source patch
+     * of each target patch) is initialized from the field of the coarser level if any, then the
+     * matching and the voting steps alternate. On return, the field is the one of this level.
+     */
+    void ExemplarLevel(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, cv::Mat &field, int iterations, int radius);
+    
+    /**
+     * One PatchMatch pass on a range of bands of rows: propagation from the previous pixel of the
+     * row and of the column in the scan order (reversed on odd passes), then random search around
+     * the best match. Neighbors outside of the band are read from the field of the previous pass.
+     * The random numbers only depend on the pass and on the row.
+     */
+    class PatchMatchPass : public cv::ParallelLoopBody
+    {
+    public:
+        PatchMatchPass(cv::Mat const &u, cv::Mat const &targets, cv::Mat const &sources, int radius, int pass,
+                       cv::Mat const &previous, cv::Mat &field, cv::Mat &distances)
+        : u_(u), targets_(targets), sources_(sources), radius_(radius), pass_(pass), previous_(previous),
+          field_(field), distances_(distances) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        /**
+         * Replaces the best match of p by the candidate if it is a better source patch
+         */
+        void improve(cv::Point p, cv::Point candidate, cv::Point &best, float &bestDistance) const;
+        
+        cv::Mat const &u_;
+        cv::Mat const &targets_;
+        cv::Mat const &sources_;
+        int radius_;
+        int pass_;
+        cv::Mat const &previous_;
+        cv::Mat &field_;
+        cv::Mat &distances_;
+    };
+    
+    /**
+     * Distances of the target patches to their current matches, on a range of rows
+     */
+    class PatchDistances : public cv::ParallelLoopBody
+    {
+    public:
+        PatchDistances(cv::Mat const &u, cv::Mat const &targets, cv::Mat const &field, int radius, cv::Mat &distances)
+        : u_(u), targets_(targets), field_(field), radius_(radius), distances_(distances) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &u_;
+        cv::Mat const &targets_;
+        cv::Mat const &field_;
+        int radius_;
+        cv::Mat &distances_;
+    };
+    
+    /**
+     * Voting on a range of rows: each missing pixel gathers the values proposed by the matches of
+     * all the target patches that cover it. These values are known pixels, so u is updated in place.
+     */
+    class PatchVote : public cv::ParallelLoopBody
+    {
+    public:
+        PatchVote(cv::Mat const &mask, cv::Mat const &targets, cv::Mat const &field, cv::Mat const &weights,
+                  int radius, cv::Mat &u)
+        : mask_(mask), targets_(targets), field_(field), weights_(weights), radius_(radius), u_(u) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &mask_;
+        cv::Mat const &targets_;
+        cv::Mat const &field_;
+        cv::Mat const &weights_;
+        int radius_;
+        cv::Mat &u_;
+    };
+}
+
+void cds::CopyKnownPixels(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u)
+{
+    int const channels = g.channels();
+    
+    for (int y = 0; y < g.rows; ++y)
+    {
+        float const *p_g = g.ptr<float>(y);
+        float const *p_mask = mask.ptr<float>(y);
+        float *p_u = u.ptr<float>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            if (p_mask[x])
+            {
+                std::copy(p_g + x*channels, p_g + (x+1)*channels, p_u + x*channels);
+            }
+        }
+    }
+}
+
+float cds::PatchDistance(cv::Mat const &u, cv::Point p, cv::Point q, int radius, float bound)
+{
+    int const channels = u.channels();
+    int const x0 = MAX(-radius, -p.x);
+    int const x1 = MIN(radius, u.cols - 1 - p.x);
+    int const y0 = MAX(-radius, -p.y);
+    int const y1 = MIN(radius, u.rows - 1 - p.y);
+    
+    int const length = (x1 - x0 + 1) * channels;
+    float const count = static_cast<float>(length * (y1 - y0 + 1));
+    float const limit = bound * count;
+    
+    float sum = 0.0f;
+    for (int dy = y0; dy <= y1; ++dy)
+    {
+        float const *a = u.ptr<float>(p.y + dy) + (p.x + x0)*channels;
+        float const *b = u.ptr<float>(q.y + dy) + (q.x + x0)*channels;
+        
+        for (int k = 0; k < length; ++k)
+        {
+            float const d = a[k] - b[k];
+            sum += d * d;
+        }
+        
+        if (sum > limit)
+        {
+            break;
+        }
+    }
+    
+    return sum / count;
+}
+
+void cds::PatchMatchPass::improve(cv::Point p, cv::Point candidate, cv::Point &best, float &bestDistance) const
+{
+    if (candidate.x < 0 || candidate.y < 0 || candidate.x >= u_.cols || candidate.y >= u_.rows ||
+        !sources_.at<uchar>(candidate.y, candidate.x) || candidate == best)
+    {
+        return;
+    }
+    
+    float const d = cds::PatchDistance(u_, p, candidate, radius_, bestDistance);
+    if (d < bestDistance)
+    {
+        best = candidate;
+        bestDistance = d;
+    }
+}
+
+void cds::PatchMatchPass::operator()(cv::Range const &range) const
+{
+    bool const forward = (pass_ % 2 == 0);
+    int const step = (forward ? 1 : -1);
+    int const searchRadius = MAX(u_.rows, u_.cols);
+    
+    for (int band = range.start; band < range.end; ++band)
+    {
+        int const yBegin = band * EXEMPLAR_BAND_HEIGHT;
+        int const yEnd = MIN(yBegin + EXEMPLAR_BAND_HEIGHT, u_.rows);
+        
+        for (int i = 0; i < yEnd - yBegin; ++i)
+        {
+            int const y = (forward ? yBegin + i : yEnd - 1 - i);
+            int const ny = y - step;
+            bool const hasPrevRow = (ny >= 0 && ny < u_.rows);
+            cv::Mat const &prevRowField = (ny >= yBegin && ny < yEnd ? field_ : previous_);
+            
+            cv::RNG rng(0x9E3779B9u * static_cast<unsigned>(pass_ + 1) + static_cast<unsigned>(y));
+            uchar const *p_targets = targets_.ptr<uchar>(y);
+            
+            for (int j = 0; j < u_.cols; ++j)
+            {
+                int const x = (forward ? j : u_.cols - 1 - j);
+                if (!p_targets[x])
+                {
+                    continue;
+                }
+                
+                cv::Point const p(x, y);
+                cv::Vec2i const &match = field_.at<cv::Vec2i>(y, x);
+                cv::Point best(match[0], match[1]);
+                float bestDistance = distances_.at<float>(y, x);
+                
+                // Propagation: the neighbor's match, shifted back by one pixel
+                int const nx = x - step;
+                if (nx >= 0 && nx < u_.cols && p_targets[nx])
+                {
+                    cv::Vec2i const &neighbor = field_.at<cv::Vec2i>(y, nx);
+                    improve(p, cv::Point(neighbor[0] + step, neighbor[1]), best, bestDistance);
+                }
+                if (hasPrevRow && targets_.at<uchar>(ny, x))
+                {
+                    cv::Vec2i const &neighbor = prevRowField.at<cv::Vec2i>(ny, x);
+                    improve(p, cv::Point(neighbor[0], neighbor[1] + step), best, bestDistance);
+                }
+                
+                // Random search in windows of exponentially decreasing size around the best match
+                for (int w = searchRadius; w >= 1; w /= 2)
+                {
+                    cv::Point candidate(best.x + rng.uniform(-w, w + 1), best.y + rng.uniform(-w, w + 1));
+                    candidate.x = MIN(MAX(candidate.x, 0), u_.cols - 1);
+                    candidate.y = MIN(MAX(candidate.y, 0), u_.rows - 1);
+                    improve(p, candidate, best, bestDistance);
+                }
+                
+                field_.at<cv::Vec2i>(y, x) = cv::Vec2i(best.x, best.y);
+                distances_.at<float>(y, x) = bestDistance;
+            }
+        }
+    }
+}
+
+void cds::PatchDistances::operator()(cv::Range const &range) const
+{
+    for (int y = range.start; y < range.end; ++y)
+    {
+        uchar const *p_targets = targets_.ptr<uchar>(y);
+        
+        for (int x = 0; x < u_.cols; ++x)
+        {
+            if (p_targets[x])
+            {
+                cv::Vec2i const &match = field_.at<cv::Vec2i>(y, x);
+                distances_.at<float>(y, x) = cds::PatchDistance(u_, cv::Point(x, y), cv::Point(match[0], match[1]),
+                                                                radius_, FLT_MAX);
+            }
+        }
+    }
+}
+
+void cds::PatchVote::operator()(cv::Range const &range) const
+{
+    int const channels = u_.channels();
+    float sums[4];
+    
+    for (int y = range.start; y < range.end; ++y)
+    {
+        float const *p_mask = mask_.ptr<float>(y);
+        float *p_u = u_.ptr<float>(y);
+        
+        for (int x = 0; x < u_.cols; ++x)
+        {
+            if (p_mask[x])
+            {
+                continue;
+            }
+            
+            std::fill(sums, sums + channels, 0.0f);
+            float weightSum = 0.0f;
+            
+            // The patch centered on (x-dx, y-dy) proposes the pixel at (dx, dy) from the center of its match
+            for (int dy = -radius_; dy <= radius_; ++dy)
+            {
+                int const py = y - dy;
+                if (py < 0 || py >= u_.rows)
+                {
+                    continue;
+                }
+                
+                for (int dx = -radius_; dx <= radius_; ++dx)
+                {
+                    int const px = x - dx;
+                    if (px < 0 || px >= u_.cols || !targets_.at<uchar>(py, px))
+                    {
+                        continue;
+                    }
+                    
+                    cv::Vec2i const &match = field_.at<cv::Vec2i>(py, px);
+                    float const w = weights_.at<float>(py, px);
+                    float const *source = u_.ptr<float>(match[1] + dy) + (match[0] + dx)*channels;
+                    
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        sums[c] += w * source[c];
+                    }
+                    weightSum += w;
+                }
+            }
+            
+            if (weightSum > 0.0f)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    p_u[x*channels + c] = sums[c] / weightSum;
+                }
+            }
+        }
+    }
+}
+
+void cds::ExemplarLevel(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, cv::Mat &field, int iterations, int radius)
+{
+    // Targets: the patches that overlap the hole. Sources: the patches inside the image that are fully known.
+    cv::Mat hole(g.size(), CV_8UC1), known(g.size(), CV_8UC1);
+    for (int y = 0; y < g.rows; ++y)
+    {
+        float const *p_mask = mask.ptr<float>(y);
+        uchar *p_hole = hole.ptr<uchar>(y);
+        uchar *p_known = known.ptr<uchar>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            p_hole[x] = (p_mask[x] ? 0 : 1);
+            p_known[x] = 1 - p_hole[x];
+        }
+    }
+    
+    cv::Mat kernel = cv::Mat::ones(2*radius + 1, 2*radius + 1, CV_8UC1);
+    cv::Mat targets, sources;
+    cv::dilate(hole, targets, kernel);
+    cv::erode(known, sources, kernel);
+    
+    std::vector<cv::Point> sourceList;
+    int targetCount = 0;
+    for (int y = 0; y < g.rows; ++y)
+    {
+        uchar *p_sources = sources.ptr<uchar>(y);
+        uchar const *p_targets = targets.ptr<uchar>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            if (x < radius || y < radius || x >= g.cols - radius || y >= g.rows - radius)
+            {
+                p_sources[x] = 0;
+            }
+            else if (p_sources[x])
+            {
+                sourceList.push_back(cv::Point(x, y));
+            }
+            targetCount += (p_targets[x] ? 1 : 0);
+        }
+    }
+    
+    // Nothing to fill, or too few known patches to copy from (scattered missing pixels, better
+    // filled by the smooth initialization)
+    if (targetCount == 0 || 8*(int)sourceList.size() < targetCount)
+    {
+        field.release();
+        return;
+    }
+    
+    // Initial field: the coarse matches upsampled, or random sources
+    cv::Mat coarseField = field;
+    field.create(g.size(), CV_32SC2);
+    field.setTo(cv::Scalar(-1, -1));
+    
+    cv::RNG rng(0x9E3779B9u);
+    for (int y = 0; y < g.rows; ++y)
+    {
+        uchar const *p_targets = targets.ptr<uchar>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            if (!p_targets[x])
+            {
+                continue;
+            }
+            
+            cv::Point match(-1, -1);
+            if (coarseField.data && y/2 < coarseField.rows && x/2 < coarseField.cols)
+            {
+                cv::Vec2i const &coarse = coarseField.at<cv::Vec2i>(y/2, x/2);
+                if (coarse[0] >= 0)
+                {
+                    match.x = MIN(MAX(2*coarse[0] + x%2, radius), g.cols - 1 - radius);
+                    match.y = MIN(MAX(2*coarse[1] + y%2, radius), g.rows - 1 - radius);
+                }
+            }
+            
+            if (match.x < 0 || !sources.at<uchar>(match.y, match.x))
+            {
+                match = sourceList[rng.uniform(0, (int)sourceList.size())];
+            }
+            
+            field.at<cv::Vec2i>(y, x) = cv::Vec2i(match.x, match.y);
+        }
+    }
+    
+    cv::Mat distances(g.size(), CV_32FC1, cv::Scalar(0));
+    cv::Mat weights(g.size(), CV_32FC1, cv::Scalar(0));
+    cv::Mat previous;
+    int const bands = (g.rows + EXEMPLAR_BAND_HEIGHT - 1) / EXEMPLAR_BAND_HEIGHT;
+    std::vector<float> targetDistances;
+    
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        // The hole has changed since the last vote
+        cv::parallel_for_(cv::Range(0, g.rows), cds::PatchDistances(u, targets, field, radius, distances));
+        
+        for (int pass = 0; pass < EXEMPLAR_PATCHMATCH_PASSES; ++pass)
+        {
+            field.copyTo(previous);
+            cv::parallel_for_(cv::Range(0, bands),
+                              cds::PatchMatchPass(u, targets, sources, radius, iteration*EXEMPLAR_PATCHMATCH_PASSES + pass,
+                                                  previous, field, distances));
+        }
+        
+        // Weights exp(-d / 2s^2), with s^2 a percentile of the distances as in [1]
+        targetDistances.clear();
+        for (int y = 0; y < g.rows; ++y)
+        {
+            for (int x = 0; x < g.cols; ++x)
+            {
+                if (targets.at<uchar>(y, x))
+                {
+                    targetDistances.push_back(distances.at<float>(y, x));
+                }
+            }
+        }
+        
+        std::vector<float>::iterator nth = targetDistances.begin() +
+            static_cast<int>(EXEMPLAR_WEIGHT_PERCENTILE * (targetDistances.size() - 1));
+        std::nth_element(targetDistances.begin(), nth, targetDistances.end());
+        float const scale = -0.5f / MAX(*nth, 1e-6f);
+        
+        for (int y = 0; y < g.rows; ++y)
+        {
+            for (int x = 0; x < g.cols; ++x)
+            {
+                weights.at<float>(y, x) = std::exp(scale * distances.at<float>(y, x));
+            }
+        }
+        
+        cv::parallel_for_(cv::Range(0, g.rows), cds::PatchVote(mask, targets, field, weights, radius, u));
+    }
+}
+
+void cds::ExemplarInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations, int levels, int patchRadius)
+{
+	if(!g.data || !mask.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(mask.type() == CV_32FC1 && mask.size() == g.size());
+    CV_Assert(patchRadius > 0);
+    
+    // Pyramid of observations, level 0 is the full resolution; the coarsest level must hold a few patches
+    int const minimalSize = 3 * (2*patchRadius + 1);
+    std::vector<cv::Mat> gPyramid(1, g);
+    std::vector<cv::Mat> maskPyramid(1, mask);
+    
+    while ((int)gPyramid.size() < levels && MIN(gPyramid.back().rows, gPyramid.back().cols) >= 2*minimalSize)
+    {
+        cv::Mat coarseG, coarseMask;
+        cds::DownsampleMaskedImage(gPyramid.back(), maskPyramid.back(), coarseG, coarseMask);
+        
+        gPyramid.push_back(coarseG);
+        maskPyramid.push_back(coarseMask);
+    }
+    
+    // The smooth TV fill is the starting point of the coarsest level
+    int coarsest = (int)gPyramid.size() - 1;
+    
+    cv::Mat uLevel;
+    cds::TvInpainting(gPyramid[coarsest], maskPyramid[coarsest], uLevel, 100);
+    cds::CopyKnownPixels(gPyramid[coarsest], maskPyramid[coarsest], uLevel);
+    
+    cv::Mat field;
+    for (int level = coarsest; level >= 0; --level)
+    {
+        if (level < coarsest)
+        {
+            cv::resize(uLevel, uLevel, gPyramid[level].size(), 0, 0, cv::INTER_LINEAR);
+            cds::CopyKnownPixels(gPyramid[level], maskPyramid[level], uLevel);
+        }
+        
+        cds::ExemplarLevel(gPyramid[level], maskPyramid[level], uLevel, field, iterations, patchRadius);
+    }
+    
+    u = uLevel;
+}
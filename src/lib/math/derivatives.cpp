@@ -26,7 +26,7 @@
 
 void cds::HorizontalGradientWithBackwardScheme(cv::Mat const &X, cv::Mat &Dx)
 {
-    Dx.create(X.size(), CV_32F);
+    Dx.create(X.size(), CV_MAKETYPE(CV_32F, X.channels()));
     Dx.setTo(cv::Scalar::all(0));
     
     int valuesPerRow = (X.cols-1) * X.channels();
@@ -48,7 +48,7 @@ void cds::VerticalGradientWithBackwardScheme(cv::Mat const &X, cv::Mat &Dx)
     if (!X.data)
         return;
 
-    Dx.create(X.size(), CV_32F);
+    Dx.create(X.size(), CV_MAKETYPE(CV_32F, X.channels()));
     Dx.setTo(cv::Scalar::all(0));
     
     int valuesPerRow = X.channels() * X.cols;
@@ -75,7 +75,7 @@ void cds::DivergenceWithBackwardScheme(cv::Mat const &X1, cv::Mat const &X2, cv:
         return;
     }
     
-	divX.create(X1.size(), CV_32FC1);
+	divX.create(X1.size(), CV_MAKETYPE(CV_32F, X1.channels()));
 	divX.setTo(cv::Scalar::all(0));
     
 	cv::Mat DX1;
@@ -85,6 +85,34 @@ void cds::DivergenceWithBackwardScheme(cv::Mat const &X1, cv::Mat const &X2, cv:
     cds::VerticalGradientWithBackwardScheme(X2, DX2);
 	
 	divX = DX1 + DX2;
+	
+	// Boundary terms, so that -div is the adjoint of the forward gradient:
+	// X1 (resp. X2) is 0 before the first column (resp. row) and ignored on the last one
+	int channels = divX.channels();
+	int last = (divX.cols - 1) * channels;
+	
+	for (int i = 0; i < divX.rows; ++i)
+	{
+		const float *x1 = X1.ptr<float>(i);
+		float *pdiv = divX.ptr<float>(i);
+		
+		for (int c = 0; c < channels; ++c)
+		{
+			pdiv[c] += x1[c];
+			pdiv[last+c] -= x1[last+c];
+		}
+	}
+	
+	float *pdiv0 = divX.ptr<float>(0);
+	float *pdivN = divX.ptr<float>(divX.rows-1);
+	const float *x20 = X2.ptr<float>(0);
+	const float *x2N = X2.ptr<float>(X2.rows-1);
+	
+	for (int j = 0; j < divX.cols * channels; ++j)
+	{
+		pdiv0[j] += x20[j];
+		pdivN[j] -= x2N[j];
+	}
 }
 
 void cds::HorizontalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx)
@@ -94,17 +122,20 @@ void cds::HorizontalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx)
         return;
     }
     
-    Dx.create(X.size(), CV_32FC1);
+    Dx.create(X.size(), CV_MAKETYPE(CV_32F, X.channels()));
     Dx.setTo(cv::Scalar::all(0));
     
+    // The last column is left to 0 (Neumann boundary condition)
+    int valuesPerRow = (X.cols-1) * X.channels();
+    
     for (int i=0; i<X.rows; ++i) 
     {
-        register const float *xj = X.ptr<float>(i);
-        register const float *xjp1 = xj + X.channels();
+        const float *xj = X.ptr<float>(i);
+        const float *xjp1 = xj + X.channels();
         
-        register float *pdx = Dx.ptr<float>(i);
+        float *pdx = Dx.ptr<float>(i);
         
-        for (int j=0; j < X.cols; ++j, ++xj, ++xjp1, ++pdx)
+        for (int j=0; j < valuesPerRow; ++j, ++xj, ++xjp1, ++pdx)
             *pdx = (*xjp1 - *xj);
     }
 }
@@ -114,7 +145,7 @@ void cds::VerticalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx)
     if (!X.data)
         return;
     
-    Dx.create(X.size(), CV_32FC1);
+    Dx.create(X.size(), CV_MAKETYPE(CV_32F, X.channels()));
     Dx.setTo(cv::Scalar::all(0));
     
     int valuesPerRow = X.cols * X.channels();
@@ -128,7 +159,7 @@ void cds::VerticalGradientWithForwardScheme(cv::Mat const &X, cv::Mat &Dx)
         
         float *pdy = Dx.ptr<float>(i);
         
-        for (int j = 0; j < X.cols; ++j, ++xi, ++xip1, ++pdy)
+        for (int j = 0; j < valuesPerRow; ++j, ++xi, ++xip1, ++pdy)
             *pdy = (*xip1 - *xi);
     }
 }
@@ -0,0 +1,393 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/math/poisson.hpp>
+#include <cds/math/derivatives.hpp>
+
+#include <vector>
+
+// Gauss-Seidel sweeps before and after the coarse correction, and on the coarsest level
+#define POISSON_PRE_SMOOTHING 2
+#define POISSON_POST_SMOOTHING 2
+#define POISSON_COARSEST_SMOOTHING 50
+
+namespace cds
+{
+    /**
+     * Half of a red-black Gauss-Seidel sweep on a range of rows: the free pixels (x+y)%2 == parity
+     * are set to the solution of the 5-point equation given their neighbors, which all have the
+     * other parity.
+     */
+    class PoissonSmoothing : public cv::ParallelLoopBody
+    {
+    public:
+        PoissonSmoothing(cv::Mat const &free, cv::Mat const &f, int parity, cv::Mat &u)
+        : free_(free), f_(f), parity_(parity), u_(u) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &free_;
+        cv::Mat const &f_;
+        int parity_;
+        cv::Mat &u_;
+    };
+    
+    /**
+     * Red-black Gauss-Seidel sweeps
+     */
+    void PoissonSmooth(cv::Mat const &free, cv::Mat const &f, cv::Mat &u, int sweeps);
+    
+    /**
+     * r = f - div(grad u) on the free pixels, 0 elsewhere
+     */
+    void PoissonResidual(cv::Mat const &free, cv::Mat const &f, cv::Mat const &u, cv::Mat &r);
+    
+    /**
+     * The free pixels of the coarse level are the blocks of 2x2 free pixels (clipped to the image)
+     * @return The number of free coarse pixels
+     */
+    int RestrictPoissonMask(cv::Mat const &free, cv::Mat &coarseFree);
+    
+    /**
+     * Right-hand side of the coarse equation: the mean of the residual on each free block,
+     * times 4 since the spacing of the coarse grid is 2
+     */
+    void RestrictPoissonResidual(cv::Mat const &r, cv::Mat const &coarseFree, cv::Mat &coarseF);
+    
+    /**
+     * Adds the bilinear interpolation of the coarse correction e to u, on the free pixels
+     */
+    void ProlongPoissonCorrection(cv::Mat const &e, cv::Mat const &free, cv::Mat &u);
+    
+    /**
+     * V-cycle for div(grad u) = f on the free pixels of a level, starting from u
+     */
+    void PoissonVCycle(std::vector<cv::Mat> const &free, int level, cv::Mat const &f, cv::Mat &u);
+}
+
+void cds::PoissonSmoothing::operator()(cv::Range const &range) const
+{
+    int const cn = u_.channels();
+    int const cols = u_.cols;
+    float sums[4];
+    
+    for (int y = range.start; y < range.end; ++y)
+    {
+        uchar const *p_free = free_.ptr<uchar>(y);
+        float const *p_f = f_.ptr<float>(y);
+        float *p_u = u_.ptr<float>(y);
+        float const *p_up = (y > 0 ? u_.ptr<float>(y-1) : 0);
+        float const *p_down = (y < u_.rows - 1 ? u_.ptr<float>(y+1) : 0);
+        
+        for (int x = (y + parity_) % 2; x < cols; x += 2)
+        {
+            if (!p_free[x])
+            {
+                continue;
+            }
+            
+            // Neighbors inside the image (Neumann boundary conditions)
+            int count = 0;
+            for (int c = 0; c < cn; ++c)
+            {
+                sums[c] = 0.0f;
+            }
+            if (x > 0)
+            {
+                for (int c = 0; c < cn; ++c) sums[c] += p_u[(x-1)*cn + c];
+                ++count;
+            }
+            if (x < cols - 1)
+            {
+                for (int c = 0; c < cn; ++c) sums[c] += p_u[(x+1)*cn + c];
+                ++count;
+            }
+            if (p_up)
+            {
+                for (int c = 0; c < cn; ++c) sums[c] += p_up[x*cn + c];
+                ++count;
+            }
+            if (p_down)
+            {
+                for (int c = 0; c < cn; ++c) sums[c] += p_down[x*cn + c];
+                ++count;
+            }
+            
+            if (count > 0)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    p_u[x*cn + c] = (sums[c] - p_f[x*cn + c]) / count;
+                }
+            }
+        }
+    }
+}
+
+void cds::PoissonSmooth(cv::Mat const &free, cv::Mat const &f, cv::Mat &u, int sweeps)
+{
+    for (int sweep = 0; sweep < sweeps; ++sweep)
+    {
+        cv::parallel_for_(cv::Range(0, u.rows), cds::PoissonSmoothing(free, f, 0, u));
+        cv::parallel_for_(cv::Range(0, u.rows), cds::PoissonSmoothing(free, f, 1, u));
+    }
+}
+
+void cds::PoissonResidual(cv::Mat const &free, cv::Mat const &f, cv::Mat const &u, cv::Mat &r)
+{
+    cv::Mat ux, uy, laplacian;
+    cds::HorizontalGradientWithForwardScheme(u, ux);
+    cds::VerticalGradientWithForwardScheme(u, uy);
+    cds::DivergenceWithBackwardScheme(ux, uy, laplacian);
+    
+    r = f - laplacian;
+    
+    int const cn = r.channels();
+    for (int y = 0; y < r.rows; ++y)
+    {
+        uchar const *p_free = free.ptr<uchar>(y);
+        float *p_r = r.ptr<float>(y);
+        
+        for (int x = 0; x < r.cols; ++x)
+        {
+            if (!p_free[x])
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    p_r[x*cn + c] = 0.0f;
+                }
+            }
+        }
+    }
+}
+
+int cds::RestrictPoissonMask(cv::Mat const &free, cv::Mat &coarseFree)
+{
+    coarseFree.create((free.rows + 1) / 2, (free.cols + 1) / 2, CV_8UC1);
+    int count = 0;
+    
+    for (int y = 0; y < coarseFree.rows; ++y)
+    {
+        uchar const *p_free0 = free.ptr<uchar>(2*y);
+        uchar const *p_free1 = free.ptr<uchar>(MIN(2*y + 1, free.rows - 1));
+        uchar *p_coarse = coarseFree.ptr<uchar>(y);
+        
+        for (int x = 0; x < coarseFree.cols; ++x)
+        {
+            int const x1 = MIN(2*x + 1, free.cols - 1);
+            p_coarse[x] = (p_free0[2*x] && p_free0[x1] && p_free1[2*x] && p_free1[x1]) ? 1 : 0;
+            count += p_coarse[x];
+        }
+    }
+    
+    return count;
+}
+
+void cds::RestrictPoissonResidual(cv::Mat const &r, cv::Mat const &coarseFree, cv::Mat &coarseF)
+{
+    int const cn = r.channels();
+    coarseF = cv::Mat::zeros(coarseFree.size(), r.type());
+    
+    for (int y = 0; y < coarseF.rows; ++y)
+    {
+        uchar const *p_coarse = coarseFree.ptr<uchar>(y);
+        float *p_f = coarseF.ptr<float>(y);
+        int const rows = MIN(2, r.rows - 2*y);
+        
+        for (int x = 0; x < coarseF.cols; ++x)
+        {
+            if (!p_coarse[x])
+            {
+                continue;
+            }
+            
+            int const cols = MIN(2, r.cols - 2*x);
+            float const scale = 4.0f / (rows * cols);
+            
+            for (int dy = 0; dy < rows; ++dy)
+            {
+                float const *p_r = r.ptr<float>(2*y + dy) + 2*x*cn;
+                
+                for (int k = 0; k < cols*cn; ++k)
+                {
+                    p_f[x*cn + k % cn] += scale * p_r[k];
+                }
+            }
+        }
+    }
+}
+
+void cds::ProlongPoissonCorrection(cv::Mat const &e, cv::Mat const &free, cv::Mat &u)
+{
+    int const cn = u.channels();
+    
+    for (int y = 0; y < u.rows; ++y)
+    {
+        // Cell-centered interpolation: weights 3/4 for the parent, 1/4 for its nearest neighbor
+        int const y0 = y / 2;
+        int const y1 = MIN(MAX(y % 2 ? y0 + 1 : y0 - 1, 0), e.rows - 1);
+        float const *p_e0 = e.ptr<float>(y0);
+        float const *p_e1 = e.ptr<float>(y1);
+        uchar const *p_free = free.ptr<uchar>(y);
+        float *p_u = u.ptr<float>(y);
+        
+        for (int x = 0; x < u.cols; ++x)
+        {
+            if (!p_free[x])
+            {
+                continue;
+            }
+            
+            int const x0 = x / 2;
+            int const x1 = MIN(MAX(x % 2 ? x0 + 1 : x0 - 1, 0), e.cols - 1);
+            
+            for (int c = 0; c < cn; ++c)
+            {
+                p_u[x*cn + c] += 0.5625f * p_e0[x0*cn + c] + 0.1875f * (p_e0[x1*cn + c] + p_e1[x0*cn + c])
+                               + 0.0625f * p_e1[x1*cn + c];
+            }
+        }
+    }
+}
+
+void cds::PoissonVCycle(std::vector<cv::Mat> const &free, int level, cv::Mat const &f, cv::Mat &u)
+{
+    if (level + 1 == (int)free.size())
+    {
+        cds::PoissonSmooth(free[level], f, u, POISSON_COARSEST_SMOOTHING);
+        return;
+    }
+    
+    cds::PoissonSmooth(free[level], f, u, POISSON_PRE_SMOOTHING);
+    
+    // Coarse correction, with homogeneous Dirichlet conditions on the known coarse pixels
+    cv::Mat r, coarseF;
+    cds::PoissonResidual(free[level], f, u, r);
+    cds::RestrictPoissonResidual(r, free[level + 1], coarseF);
+    
+    cv::Mat e = cv::Mat::zeros(coarseF.size(), coarseF.type());
+    cds::PoissonVCycle(free, level + 1, coarseF, e);
+    cds::ProlongPoissonCorrection(e, free[level], u);
+    
+    cds::PoissonSmooth(free[level], f, u, POISSON_POST_SMOOTHING);
+}
+
+void cds::PoissonInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat const &f, cv::Mat &u, int cycles)
+{
+	if(!g.data || !mask.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(mask.type() == CV_32FC1 && mask.size() == g.size());
+    CV_Assert(!f.data || (f.size() == g.size() && f.type() == g.type()));
+    
+    int const cn = g.channels();
+    
+    // Free pixels of the levels, coarsened while the holes do not vanish
+    std::vector<cv::Mat> free(1, cv::Mat(g.size(), CV_8UC1));
+    for (int y = 0; y < g.rows; ++y)
+    {
+        float const *p_mask = mask.ptr<float>(y);
+        uchar *p_free = free[0].ptr<uchar>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            p_free[x] = (p_mask[x] ? 0 : 1);
+        }
+    }
+    
+    while (MIN(free.back().rows, free.back().cols) > 2)
+    {
+        cv::Mat coarseFree;
+        if (cds::RestrictPoissonMask(free.back(), coarseFree) == 0)
+        {
+            break;
+        }
+        free.push_back(coarseFree);
+    }
+    
+    // Starting point: u = g on the known pixels, and the mean of the known pixels on the holes
+    // if u is not given
+    bool warm = (u.size() == g.size() && u.type() == g.type());
+    if (!warm)
+    {
+        u.create(g.size(), g.type());
+    }
+    
+    double means[4] = {0.0, 0.0, 0.0, 0.0};
+    int known = 0;
+    for (int y = 0; y < g.rows; ++y)
+    {
+        uchar const *p_free = free[0].ptr<uchar>(y);
+        float const *p_g = g.ptr<float>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            if (!p_free[x])
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    means[c] += p_g[x*cn + c];
+                }
+                ++known;
+            }
+        }
+    }
+    
+    for (int y = 0; y < g.rows; ++y)
+    {
+        uchar const *p_free = free[0].ptr<uchar>(y);
+        float const *p_g = g.ptr<float>(y);
+        float *p_u = u.ptr<float>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            for (int c = 0; c < cn; ++c)
+            {
+                if (!p_free[x])
+                {
+                    p_u[x*cn + c] = p_g[x*cn + c];
+                }
+                else if (!warm)
+                {
+                    p_u[x*cn + c] = (known > 0 ? static_cast<float>(means[c] / known) : 0.0f);
+                }
+            }
+        }
+    }
+    
+    cv::Mat rhs = (f.data ? f : cv::Mat::zeros(g.size(), g.type()));
+    
+    for (int cycle = 0; cycle < cycles; ++cycle)
+    {
+        cds::PoissonVCycle(free, 0, rhs, u);
+    }
+}
+
+void cds::HarmonicInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int cycles)
+{
+    cds::PoissonInpainting(g, mask, cv::Mat(), u, cycles);
+}
@@ -0,0 +1,351 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/motion/opticalflow.hpp>
+#include <cds/math/derivatives.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Smallest side of the coarsest level of the pyramids
+#define OPTICALFLOW_MIN_SIZE 16
+
+namespace cds
+{
+    /**
+     * Data step of TV-L1 on a range of rows [1]: v = argmin |v-u|^2/(2*theta) + lambda*|rho(v)|, where
+     * rho(v) = I1w + grad(I1w).(v-u0) - I0 is the data term linearized around the flow u0 of the warp
+     * (I1w is I1 warped by u0), which is a thresholding of rho(u) along grad(I1w).
+     */
+    class TvL1Thresholding : public cv::ParallelLoopBody
+    {
+    public:
+        TvL1Thresholding(cv::Mat const &I0, cv::Mat const &warped, cv::Mat const &warpedX, cv::Mat const &warpedY,
+                         cv::Mat const &flow0, cv::Mat const &flow, float lambdaTheta, cv::Mat &v)
+        : I0_(I0), warped_(warped), warpedX_(warpedX), warpedY_(warpedY), flow0_(flow0), flow_(flow),
+          lambdaTheta_(lambdaTheta), v_(v) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &I0_;
+        cv::Mat const &warped_;
+        cv::Mat const &warpedX_;
+        cv::Mat const &warpedY_;
+        cv::Mat const &flow0_;
+        cv::Mat const &flow_;
+        float lambdaTheta_;
+        cv::Mat &v_;
+    };
+    
+    /**
+     * Maps of the warp on a range of rows: (x + u1, y + u2)
+     */
+    class FlowMaps : public cv::ParallelLoopBody
+    {
+    public:
+        FlowMaps(cv::Mat const &flow, cv::Mat &mapX, cv::Mat &mapY)
+        : flow_(flow), mapX_(mapX), mapY_(mapY) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &flow_;
+        cv::Mat &mapX_;
+        cv::Mat &mapY_;
+    };
+    
+    /**
+     * Multiplies the 2 components of a flow by sx and sy, when it changes of level
+     */
+    void ScaleFlow(cv::Mat &flow, float sx, float sy);
+}
+
+void cds::TvL1Thresholding::operator()(cv::Range const &range) const
+{
+    for (int y = range.start; y < range.end; ++y)
+    {
+        float const *p_I0 = I0_.ptr<float>(y);
+        float const *p_warped = warped_.ptr<float>(y);
+        float const *p_gx = warpedX_.ptr<float>(y);
+        float const *p_gy = warpedY_.ptr<float>(y);
+        float const *p_u0 = flow0_.ptr<float>(y);
+        float const *p_u = flow_.ptr<float>(y);
+        float *p_v = v_.ptr<float>(y);
+        
+        for (int x = 0; x < I0_.cols; ++x)
+        {
+            float const gx = p_gx[x];
+            float const gy = p_gy[x];
+            float const u1 = p_u[2*x];
+            float const u2 = p_u[2*x+1];
+            
+            float const gradSquared = gx*gx + gy*gy;
+            float const rho = p_warped[x] + gx*(u1 - p_u0[2*x]) + gy*(u2 - p_u0[2*x+1]) - p_I0[x];
+            float const threshold = lambdaTheta_ * gradSquared;
+            
+            float step = 0.0f;
+            if (rho < -threshold)
+            {
+                step = lambdaTheta_;
+            }
+            else if (rho > threshold)
+            {
+                step = -lambdaTheta_;
+            }
+            else if (gradSquared > 1e-12f)
+            {
+                step = -rho / gradSquared;
+            }
+            
+            p_v[2*x] = u1 + step*gx;
+            p_v[2*x+1] = u2 + step*gy;
+        }
+    }
+}
+
+void cds::FlowMaps::operator()(cv::Range const &range) const
+{
+    for (int y = range.start; y < range.end; ++y)
+    {
+        float const *p_flow = flow_.ptr<float>(y);
+        float *p_mapX = mapX_.ptr<float>(y);
+        float *p_mapY = mapY_.ptr<float>(y);
+        
+        for (int x = 0; x < flow_.cols; ++x)
+        {
+            p_mapX[x] = x + p_flow[2*x];
+            p_mapY[x] = y + p_flow[2*x+1];
+        }
+    }
+}
+
+void cds::ScaleFlow(cv::Mat &flow, float sx, float sy)
+{
+    for (int y = 0; y < flow.rows; ++y)
+    {
+        float *p_flow = flow.ptr<float>(y);
+        
+        for (int x = 0; x < flow.cols; ++x)
+        {
+            p_flow[2*x] *= sx;
+            p_flow[2*x+1] *= sy;
+        }
+    }
+}
+
+cds::TvL1OpticalFlow::TvL1OpticalFlow(float lambda, float theta, int levels, int warps, int iterations)
+: lambda_(lambda), theta_(theta), levels_(MAX(1, levels)), warps_(warps), iterations_(iterations), hasPrevious_(false)
+{
+    CV_Assert(lambda > 0.0f && theta > 0.0f);
+}
+
+void cds::TvL1OpticalFlow::buildPyramid(cv::Mat const &image, std::vector<cv::Mat> &pyramid) const
+{
+    int count = 1;
+    cv::Size size = image.size();
+    
+    while (count < levels_ && MIN((size.width + 1) / 2, (size.height + 1) / 2) >= OPTICALFLOW_MIN_SIZE)
+    {
+        size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+        ++count;
+    }
+    
+    pyramid.resize(count);
+    image.convertTo(pyramid[0], CV_32F, image.depth() == CV_8U ? 1.0/255.0 : 1.0);
+    
+    for (int level = 1; level < count; ++level)
+    {
+        cv::pyrDown(pyramid[level-1], pyramid[level]);
+    }
+}
+
+void cds::TvL1OpticalFlow::calc(cv::Mat const &I0, cv::Mat const &I1, cv::Mat &flow)
+{
+	if(!I0.data || !I1.data)
+	{
+		return;
+	}
+	
+    CV_Assert(I0.type() == CV_8UC1 || I0.type() == CV_32FC1);
+    CV_Assert(I0.size() == I1.size() && I0.type() == I1.type());
+    
+    buildPyramid(I0, I0_);
+    buildPyramid(I1, I1_);
+    solve(flow);
+    
+    // The next frame of a stream is compared with I1
+    hasPrevious_ = true;
+}
+
+void cds::TvL1OpticalFlow::operator()(cv::Mat const &frame, cv::Mat &flow)
+{
+	if(!frame.data)
+	{
+		return;
+	}
+	
+    CV_Assert(frame.type() == CV_8UC1 || frame.type() == CV_32FC1);
+    
+    if (!hasPrevious_ || I1_.empty() || I1_[0].size() != frame.size())
+    {
+        buildPyramid(frame, I1_);
+        hasPrevious_ = true;
+        
+        flow.create(frame.size(), CV_32FC2);
+        flow.setTo(cv::Scalar::all(0));
+        return;
+    }
+    
+    // The pyramid of the previous frame becomes I0, and its buffers are reused for the new one
+    std::swap(I0_, I1_);
+    buildPyramid(frame, I1_);
+    solve(flow);
+}
+
+void cds::TvL1OpticalFlow::solve(cv::Mat &flow)
+{
+    int const levels = (int)I0_.size();
+    int const coarsest = levels - 1;
+    
+    // State of the levels, only reallocated when the size of the frames changes
+    bool resized = ((int)flows_.size() != levels || (int)bands_.size() != levels);
+    flows_.resize(levels);
+    ubar_.resize(levels);
+    p1_.resize(levels);
+    p2_.resize(levels);
+    v_.resize(levels);
+    
+    for (int level = 0; level < levels; ++level)
+    {
+        cv::Size size = I0_[level].size();
+        resized = resized || flows_[level].size() != size;
+        
+        flows_[level].create(size, CV_32FC2);
+        ubar_[level].create(size, CV_32FC2);
+        p1_[level].create(size, CV_32FC2);
+        p2_[level].create(size, CV_32FC2);
+        v_[level].create(size, CV_32FC2);
+    }
+    
+    if (resized)
+    {
+        bands_.clear();
+        for (int level = 0; level < levels; ++level)
+        {
+            bands_.push_back(cds::PrimalDualBands(I0_[level].size(), 2, cv::getNumThreads()));
+        }
+    }
+    
+    // The work images of the warps are allocated at full resolution, the levels use their top-left part
+    cv::Size frameSize = I0_[0].size();
+    flow0_.create(frameSize, CV_32FC2);
+    mapX_.create(frameSize, CV_32FC1);
+    mapY_.create(frameSize, CV_32FC1);
+    gradX_.create(frameSize, CV_32FC1);
+    gradY_.create(frameSize, CV_32FC1);
+    warped_.create(frameSize, CV_32FC1);
+    warpedX_.create(frameSize, CV_32FC1);
+    warpedY_.create(frameSize, CV_32FC1);
+    
+    // Starting point on the coarsest level: the given flow, or 0
+    cv::Size coarseSize = I0_[coarsest].size();
+    if (flow.size() == frameSize && flow.type() == CV_32FC2)
+    {
+        cv::resize(flow, flows_[coarsest], coarseSize, 0, 0, cv::INTER_AREA);
+        cds::ScaleFlow(flows_[coarsest], (float)coarseSize.width / frameSize.width, (float)coarseSize.height / frameSize.height);
+    }
+    else
+    {
+        flows_[coarsest].setTo(cv::Scalar::all(0));
+    }
+    p1_[coarsest].setTo(cv::Scalar::all(0));
+    p2_[coarsest].setTo(cv::Scalar::all(0));
+    
+    // Coarse to fine: the flow and the dual variable of a level initialize the next one
+    for (int level = coarsest; level >= 0; --level)
+    {
+        if (level < coarsest)
+        {
+            cv::Size size = I0_[level].size();
+            cv::Size previousSize = I0_[level+1].size();
+            
+            cv::resize(flows_[level+1], flows_[level], size, 0, 0, cv::INTER_LINEAR);
+            cds::ScaleFlow(flows_[level], (float)size.width / previousSize.width, (float)size.height / previousSize.height);
+            cv::resize(p1_[level+1], p1_[level], size, 0, 0, cv::INTER_LINEAR);
+            cv::resize(p2_[level+1], p2_[level], size, 0, 0, cv::INTER_LINEAR);
+        }
+        
+        solveLevel(level);
+    }
+    
+    flows_[0].copyTo(flow);
+}
+
+void cds::TvL1OpticalFlow::solveLevel(int level)
+{
+    cv::Mat const &I0 = I0_[level];
+    cv::Mat const &I1 = I1_[level];
+    cv::Mat &flow = flows_[level];
+    
+    cv::Rect region(0, 0, I0.cols, I0.rows);
+    cv::Mat flow0 = flow0_(region);
+    cv::Mat mapX = mapX_(region);
+    cv::Mat mapY = mapY_(region);
+    cv::Mat gradX = gradX_(region);
+    cv::Mat gradY = gradY_(region);
+    cv::Mat warped = warped_(region);
+    cv::Mat warpedX = warpedX_(region);
+    cv::Mat warpedY = warpedY_(region);
+    
+    cds::HorizontalGradientWithCenteredScheme(I1, gradX);
+    cds::VerticalGradientWithCenteredScheme(I1, gradY);
+    
+    // The ROF step on u: min TV(u1) + TV(u2) + |u-v|^2/(2*theta)
+    float L2 = 8.0f;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    cds::ProxL2Pixel prox(v_[level], 1.0f / theta_, tau);
+    
+    for (int warp = 0; warp < warps_; ++warp)
+    {
+        // Linearization of the data term around the current flow
+        cv::parallel_for_(cv::Range(0, I0.rows), cds::FlowMaps(flow, mapX, mapY));
+        cv::remap(I1, warped, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        cv::remap(gradX, warpedX, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        cv::remap(gradY, warpedY, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        
+        flow.copyTo(flow0);
+        flow.copyTo(ubar_[level]);
+        
+        for (int iteration = 0; iteration < iterations_; ++iteration)
+        {
+            cv::parallel_for_(cv::Range(0, I0.rows),
+                              cds::TvL1Thresholding(I0, warped, warpedX, warpedY, flow0, flow, lambda_ * theta_, v_[level]));
+            cds::PrimalDualIterations(flow, ubar_[level], p1_[level], p2_[level], cds::TvOperator(), cds::ChannelProjectionL2Ball(),
+                                      prox, tau, sigma, 1.0f, 1, bands_[level]);
+        }
+    }
+}
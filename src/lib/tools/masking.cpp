@@ -23,6 +23,10 @@
 
 #include <cds/tools/masking.hpp>
 
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <vector>
+
 void cds::CreateRandomMask(cv::Size frameSize, float occlusionRatio, cv::Mat &mask)
 {
   mask.create(frameSize, CV_32FC1);
@@ -93,3 +97,41 @@ void cds::CreateRectangularMask(cv::Size frameSize, cv::Rect const &rectangle, c
   ROI.setTo(cv::Scalar(0));
 }
 
+void cds::DownsampleMaskedImage(cv::Mat const &g, cv::Mat const &mask, cv::Mat &coarseG, cv::Mat &coarseMask)
+{
+  cv::Size coarseSize((g.cols + 1) / 2, (g.rows + 1) / 2);
+  int const channels = g.channels();
+
+  cv::Mat maskedG;
+  if (channels == 1)
+  {
+    cv::multiply(g, mask, maskedG);
+  }
+  else
+  {
+    cv::Mat maskN;
+    cv::merge(std::vector<cv::Mat>(channels, mask), maskN);
+    cv::multiply(g, maskN, maskedG);
+  }
+
+  cv::resize(maskedG, coarseG, coarseSize, 0, 0, cv::INTER_AREA);
+  cv::resize(mask, coarseMask, coarseSize, 0, 0, cv::INTER_AREA);
+
+  for (int y = 0; y < coarseSize.height; ++y)
+  {
+    float *p_g = coarseG.ptr<float>(y);
+    float *p_mask = coarseMask.ptr<float>(y);
+
+    for (int x = 0; x < coarseSize.width; ++x, p_g += channels, ++p_mask)
+    {
+      float scale = (*p_mask > 0.0f ? 1.0f / *p_mask : 0.0f);
+
+      for (int c = 0; c < channels; ++c)
+      {
+        p_g[c] *= scale;
+      }
+
+      *p_mask = (*p_mask > 0.0f ? 1.0f : 0.0f);
+    }
+  }
+}
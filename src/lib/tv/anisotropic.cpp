@@ -0,0 +1,238 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/anisotropic.hpp>
+
+#include <vector>
+
+namespace cds
+{
+    /**
+     * Exact 1D TV denoising of [1] (Condat's direct algorithm), on the values input[k*stride]:
+     * 		argmin 0.5*|output-input|^2 + mu * sum |output(k+1) - output(k)|
+     * The output may be the input.
+     */
+    void TvDenoiseLine(float const *input, float *output, int length, int stride, float mu);
+    
+    /**
+     * Solves the 1D problem on a range of rows: y = prox(x + p), then p = x + p - y for the
+     * Dykstra-like iterations. Without p, simply y = prox(x).
+     */
+    class TvRowsStep : public cv::ParallelLoopBody
+    {
+    public:
+        TvRowsStep(cv::Mat const &x, cv::Mat &p, float mu, cv::Mat &y)
+        : x_(x), p_(p), mu_(mu), y_(y) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &x_;
+        cv::Mat &p_;
+        float mu_;
+        cv::Mat &y_;
+    };
+}
+
+void cds::TvDenoiseRows(cv::Mat const &g, cv::Mat &u, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(lambda > 0.0f);
+    
+    u.create(g.size(), g.type());
+    
+    cv::Mat noResidual;
+    cv::parallel_for_(cv::Range(0, g.rows), cds::TvRowsStep(g, noResidual, 1.0f / lambda, u));
+}
+
+void cds::TvDenoiseAnisotropic(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(lambda > 0.0f);
+    
+    float mu = 1.0f / lambda;
+    
+    // The columns are solved as the rows of the transposed images (suffix T)
+    cv::Mat x = g.clone();
+    cv::Mat p = cv::Mat::zeros(g.size(), g.type());
+    cv::Mat qT = cv::Mat::zeros(g.cols, g.rows, g.type());
+    cv::Mat y, yT, xT;
+    
+    y.create(g.size(), g.type());
+    xT.create(qT.size(), g.type());
+    
+    for (int i = 0; i < iterations; ++i)
+    {
+        // TV of the rows
+        cv::parallel_for_(cv::Range(0, x.rows), cds::TvRowsStep(x, p, mu, y));
+        
+        // TV of the columns
+        cv::transpose(y, yT);
+        cv::parallel_for_(cv::Range(0, yT.rows), cds::TvRowsStep(yT, qT, mu, xT));
+        cv::transpose(xT, x);
+    }
+    
+    u = x;
+}
+
+void cds::TvRowsStep::operator()(cv::Range const &range) const
+{
+    int channels = x_.channels();
+    int valuesPerRow = x_.cols * channels;
+    
+    std::vector<float> sum(valuesPerRow);
+    
+    for (int y = range.start; y < range.end; ++y)
+    {
+        float const *p_x = x_.ptr<float>(y);
+        float *p_y = y_.ptr<float>(y);
+        float *p_p = (p_.data ? p_.ptr<float>(y) : 0);
+        
+        for (int j = 0; j < valuesPerRow; ++j)
+        {
+            sum[j] = (p_p ? p_x[j] + p_p[j] : p_x[j]);
+        }
+        
+        for (int c = 0; c < channels; ++c)
+        {
+            cds::TvDenoiseLine(&sum[c], p_y + c, x_.cols, channels, mu_);
+        }
+        
+        if (p_p)
+        {
+            for (int j = 0; j < valuesPerRow; ++j)
+            {
+                p_p[j] = sum[j] - p_y[j];
+            }
+        }
+    }
+}
+
+/**
+ * The algorithm scans the signal once, keeping the range [vmin, vmax] of the possible values of the
+ * current segment, which starts at k0, and the corresponding dual values umin and umax. When the
+ * range becomes empty, the segment is terminated at the last point (kminus or kplus) where its value
+ * was known, and the scan restarts from there. Every point is written once and read after the
+ * points before it are written, hence the output may be the input.
+ */
+void cds::TvDenoiseLine(float const *input, float *output, int length, int stride, float mu)
+{
+    if (length <= 0)
+    {
+        return;
+    }
+    
+    int k = 0;
+    int k0 = 0;
+    int kminus = 0;
+    int kplus = 0;
+    float umin = mu;
+    float umax = -mu;
+    float vmin = input[0] - mu;
+    float vmax = input[0] + mu;
+    
+    for (;;)
+    {
+        // End of the signal: terminate the segments until the last one fits
+        while (k == length - 1)
+        {
+            if (umin < 0.0f)
+            {
+                do { output[stride * k0++] = vmin; } while (k0 <= kminus);
+                k = kminus = k0;
+                vmin = input[stride * k];
+                umin = mu;
+                umax = vmin + umin - vmax;
+            }
+            else if (umax > 0.0f)
+            {
+                do { output[stride * k0++] = vmax; } while (k0 <= kplus);
+                k = kplus = k0;
+                vmax = input[stride * k];
+                umax = -mu;
+                umin = vmax + umax - vmin;
+            }
+            else
+            {
+                vmin += umin / (k - k0 + 1);
+                do { output[stride * k0++] = vmin; } while (k0 <= k);
+                return;
+            }
+        }
+        
+        umin += input[stride * (k + 1)] - vmin;
+        
+        if (umin < -mu)
+        {
+            // Negative jump
+            do { output[stride * k0++] = vmin; } while (k0 <= kminus);
+            k = kminus = kplus = k0;
+            vmin = input[stride * k];
+            vmax = vmin + 2.0f * mu;
+            umin = mu;
+            umax = -mu;
+            continue;
+        }
+        
+        umax += input[stride * (k + 1)] - vmax;
+        
+        if (umax > mu)
+        {
+            // Positive jump
+            do { output[stride * k0++] = vmax; } while (k0 <= kplus);
+            k = kminus = kplus = k0;
+            vmax = input[stride * k];
+            vmin = vmax - 2.0f * mu;
+            umin = mu;
+            umax = -mu;
+            continue;
+        }
+        
+        // No jump: extend the segment
+        ++k;
+        
+        if (umin >= mu)
+        {
+            kminus = k;
+            vmin += (umin - mu) / (kminus - k0 + 1);
+            umin = mu;
+        }
+        
+        if (umax <= -mu)
+        {
+            kplus = k;
+            vmax += (umax + mu) / (kplus - k0 + 1);
+            umax = -mu;
+        }
+    }
+}
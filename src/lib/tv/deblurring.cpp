@@ -0,0 +1,186 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/deblurring.hpp>
+#include <cds/math/derivatives.hpp>
+
+#include <cmath>
+
+cds::TvDeblurSolver::TvDeblurSolver(cv::Mat const &psf)
+: psf_(psf.clone()), frameSize_(0, 0), type_(-1), tauLambda_(0.0f), bands_(0)
+{
+    CV_Assert(psf.type() == CV_32FC1 && psf.data);
+}
+
+cds::TvDeblurSolver::~TvDeblurSolver()
+{
+    delete bands_;
+}
+
+void cds::TvDeblurSolver::solve(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(psf_.cols <= g.cols && psf_.rows <= g.rows);
+    
+    // Numerical parameters
+    float L2 = 8.0f;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    
+    prepare(g, tau * lambda);
+    
+	if (!u.data || u.size() != g.size() || u.type() != g.type())
+	{
+		u = cv::Mat::zeros(g.size(), g.type());
+	}
+    
+    // Auxiliary point and dual variable, as in TvSolver
+    u.copyTo(ubar_);
+    cds::HorizontalGradientWithForwardScheme(u, p1_);
+    cds::VerticalGradientWithForwardScheme(u, p2_);
+    
+    for (int i = 0; i < iterations; ++i)
+    {
+        cds::PrimalDualIteration(u, ubar_, p1_, p2_, cds::ProxZeroPixel(), tau, sigma, 1.0f, *bands_);
+        proxDataTerm(u);
+    }
+}
+
+void cds::TvDeblurSolver::prepare(cv::Mat const &g, float tauLambda)
+{
+    bool newSize = (g.size() != frameSize_);
+    
+    if (newSize)
+    {
+        // The PSF is wrapped around the origin so that the convolution by it matches the correlation
+        // by psf_ of cv::filter2D
+        cv::Mat kernel = cv::Mat::zeros(g.size(), CV_32FC1);
+        cv::Point anchor(psf_.cols / 2, psf_.rows / 2);
+        
+        for (int y = 0; y < psf_.rows; ++y)
+        {
+            float const *p_psf = psf_.ptr<float>(y);
+            float *p_kernel = kernel.ptr<float>((anchor.y - y + g.rows) % g.rows);
+            
+            for (int x = 0; x < psf_.cols; ++x)
+            {
+                p_kernel[(anchor.x - x + g.cols) % g.cols] += p_psf[x];
+            }
+        }
+        
+        cv::dft(kernel, psfSpectrum_, cv::DFT_COMPLEX_OUTPUT);
+        frameSize_ = g.size();
+    }
+    
+    if (newSize || g.type() != type_)
+    {
+        type_ = g.type();
+        
+        ubar_.create(g.size(), g.type());
+        
+        delete bands_;
+        bands_ = new cds::PrimalDualBands(g.size(), g.channels(), cv::getNumThreads());
+    }
+    
+    if (newSize || tauLambda != tauLambda_)
+    {
+        denominator_.create(psfSpectrum_.size(), CV_32FC2);
+        
+        for (int y = 0; y < psfSpectrum_.rows; ++y)
+        {
+            float const *p_k = psfSpectrum_.ptr<float>(y);
+            float *p_den = denominator_.ptr<float>(y);
+            
+            for (int x = 0; x < psfSpectrum_.cols; ++x, p_k += 2, p_den += 2)
+            {
+                float value = 1.0f / (1.0f + tauLambda * (p_k[0]*p_k[0] + p_k[1]*p_k[1]));
+                p_den[0] = value;
+                p_den[1] = value;
+            }
+        }
+        
+        tauLambda_ = tauLambda;
+    }
+    
+    // Data term, once per solve
+    cv::split(g, planes_);
+    numerators_.resize(planes_.size());
+    
+    for (size_t c = 0; c < planes_.size(); ++c)
+    {
+        cv::dft(planes_[c], spectrum_, cv::DFT_COMPLEX_OUTPUT);
+        cv::mulSpectrums(spectrum_, psfSpectrum_, numerators_[c], 0, true);
+        numerators_[c] *= tauLambda;
+    }
+}
+
+void cds::TvDeblurSolver::proxDataTerm(cv::Mat &u)
+{
+    cv::split(u, planes_);
+    
+    for (size_t c = 0; c < planes_.size(); ++c)
+    {
+        cv::dft(planes_[c], spectrum_, cv::DFT_COMPLEX_OUTPUT);
+        spectrum_ += numerators_[c];
+        cv::multiply(spectrum_, denominator_, spectrum_);
+        cv::idft(spectrum_, planes_[c], cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+    }
+    
+    // The sweep set ubar = 2v - u_old from v = u_old + tau*div(p): with the new u, ubar = 2u - u_old
+    int channels = u.channels();
+    
+    for (int y = 0; y < u.rows; ++y)
+    {
+        float *p_u = u.ptr<float>(y);
+        float *p_ubar = ubar_.ptr<float>(y);
+        
+        for (int c = 0; c < channels; ++c)
+        {
+            float const *p_plane = planes_[c].ptr<float>(y);
+            
+            for (int x = 0; x < u.cols; ++x)
+            {
+                int i = x * channels + c;
+                
+                p_ubar[i] += 2.0f * (p_plane[x] - p_u[i]);
+                p_u[i] = p_plane[x];
+            }
+        }
+    }
+}
+
+void cds::TvDeblurring(cv::Mat const &g, cv::Mat const &psf, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    cds::TvDeblurSolver solver(psf);
+    solver.solve(g, u, iterations, lambda);
+}
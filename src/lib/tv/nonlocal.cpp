@@ -0,0 +1,424 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/nonlocal.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace cds
+{
+    /**
+     * Patch search on a range of rows: for each offset of the search window, the patch distances
+     * are sliding sums of the squared differences with the shifted image, and each pixel keeps
+     * its k nearest patches
+     */
+    class NonLocalSearch : public cv::ParallelLoopBody
+    {
+    public:
+        NonLocalSearch(cv::Mat const &padded, cv::Size frameSize, int neighbors, int searchRadius, int patchRadius,
+                       std::vector<float> &distances, std::vector<int> &indices)
+        : padded_(padded), frameSize_(frameSize), neighbors_(neighbors), searchRadius_(searchRadius),
+          patchRadius_(patchRadius), distances_(distances), indices_(indices) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        /**
+         * Adds sign * the squared differences of a padded row with its shifted row to the column sums
+         */
+        void accumulate(int row, int dx, int dy, double sign, std::vector<double> &columns) const;
+        
+        cv::Mat const &padded_;
+        cv::Size frameSize_;
+        int neighbors_;
+        int searchRadius_;
+        int patchRadius_;
+        std::vector<float> &distances_;
+        std::vector<int> &indices_;
+    };
+    
+    /**
+     * Dual ascent + projection onto the unit ball (edges and channels of a pixel together), for a range of rows
+     */
+    class NonLocalDualStep : public cv::ParallelLoopBody
+    {
+    public:
+        NonLocalDualStep(NonLocalGraph const &graph, float const *ubar, int channels, float sigma, std::vector<float> &p)
+        : graph_(graph), ubar_(ubar), channels_(channels), sigma_(sigma), p_(p) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        NonLocalGraph const &graph_;
+        float const *ubar_;
+        int channels_;
+        float sigma_;
+        std::vector<float> &p_;
+    };
+    
+    /**
+     * Primal descent (pointwise ProxL2) + over-relaxation, for a range of rows.
+     * The divergence gathers the outgoing and the incoming edges of each pixel.
+     */
+    class NonLocalPrimalStep : public cv::ParallelLoopBody
+    {
+    public:
+        NonLocalPrimalStep(NonLocalGraph const &graph, std::vector<float> const &p, float const *g, int channels,
+                           float tau, float lambda, float *u, float *ubar)
+        : graph_(graph), p_(p), g_(g), channels_(channels), tau_(tau), lambda_(lambda), u_(u), ubar_(ubar) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        NonLocalGraph const &graph_;
+        std::vector<float> const &p_;
+        float const *g_;
+        int channels_;
+        float tau_;
+        float lambda_;
+        float *u_;
+        float *ubar_;
+    };
+}
+
+void cds::NonLocalSearch::accumulate(int row, int dx, int dy, double sign, std::vector<double> &columns) const
+{
+    int const cn = padded_.channels();
+    float const *p_row = padded_.ptr<float>(row);
+    float const *p_shifted = padded_.ptr<float>(row + dy);
+    
+    // Columns whose shifted column is in the padded image
+    int begin = MAX(0, -dx);
+    int end = MIN(padded_.cols, padded_.cols - dx);
+    
+    for (int x = begin; x < end; ++x)
+    {
+        double d = 0.0;
+        
+        for (int c = 0; c < cn; ++c)
+        {
+            double diff = p_row[x*cn + c] - p_shifted[(x+dx)*cn + c];
+            d += diff * diff;
+        }
+        
+        columns[x] += sign * d;
+    }
+}
+
+void cds::NonLocalSearch::operator()(cv::Range const &range) const
+{
+    int const k = neighbors_;
+    int const size = 2*patchRadius_ + 1;
+    int const cols = frameSize_.width;
+    double normalization = 1.0 / (size * size * padded_.channels());
+    std::vector<double> columns(padded_.cols);
+    
+    for (int dy = -searchRadius_; dy <= searchRadius_; ++dy)
+    {
+        // Rows of the range whose neighbor row is in the frame
+        int yBegin = MAX(range.start, -dy);
+        int yEnd = MIN(range.end, frameSize_.height - dy);
+        
+        if (yBegin >= yEnd)
+        {
+            continue;
+        }
+        
+        for (int dx = -searchRadius_; dx <= searchRadius_; ++dx)
+        {
+            int xBegin = MAX(0, -dx);
+            int xEnd = MIN(cols, cols - dx);
+            
+            if ((dx == 0 && dy == 0) || xBegin >= xEnd)
+            {
+                continue;
+            }
+            
+            // Vertical sums over the patch of the first row (padded row y covers the rows y-r to y+r)
+            std::fill(columns.begin(), columns.end(), 0.0);
+            
+            for (int row = yBegin; row < yBegin + size; ++row)
+            {
+                accumulate(row, dx, dy, 1.0, columns);
+            }
+            
+            for (int y = yBegin; y < yEnd; ++y)
+            {
+                double sum = 0.0;
+                
+                for (int x = xBegin; x < xBegin + size; ++x)
+                {
+                    sum += columns[x];
+                }
+                
+                float *p_distances = &distances_[(y*cols + xBegin)*k];
+                int *p_indices = &indices_[(y*cols + xBegin)*k];
+                int neighbor = (y+dy)*cols + xBegin + dx;
+                
+                for (int x = xBegin; x < xEnd; ++x, p_distances += k, p_indices += k, ++neighbor)
+                {
+                    float d = (float)(MAX(sum, 0.0) * normalization);
+                    
+                    // Insertion in the sorted list of the k nearest patches
+                    if (d < p_distances[k-1])
+                    {
+                        int i = k-1;
+                        
+                        for (; i > 0 && p_distances[i-1] > d; --i)
+                        {
+                            p_distances[i] = p_distances[i-1];
+                            p_indices[i] = p_indices[i-1];
+                        }
+                        
+                        p_distances[i] = d;
+                        p_indices[i] = neighbor;
+                    }
+                    
+                    if (x+1 < xEnd)
+                    {
+                        sum += columns[x + size] - columns[x];
+                    }
+                }
+                
+                // Slides the vertical sums to the next row
+                if (y+1 < yEnd)
+                {
+                    accumulate(y, dx, dy, -1.0, columns);
+                    accumulate(y + size, dx, dy, 1.0, columns);
+                }
+            }
+        }
+    }
+}
+
+void cds::NonLocalDualStep::operator()(cv::Range const &range) const
+{
+    int const cn = channels_;
+    int const cols = graph_.frameSize.width;
+    
+    for (int i = range.start*cols; i < range.end*cols; ++i)
+    {
+        int begin = graph_.offsets[i];
+        int end = graph_.offsets[i+1];
+        float const *p_ubar = ubar_ + i*cn;
+        float normQ = 0.0f;
+        
+        for (int e = begin; e < end; ++e)
+        {
+            float w = sigma_ * graph_.weights[e];
+            float const *p_ubar_neighbor = ubar_ + graph_.neighbors[e]*cn;
+            float *p_p = &p_[e*cn];
+            
+            for (int c = 0; c < cn; ++c)
+            {
+                p_p[c] += w * (p_ubar_neighbor[c] - p_ubar[c]);
+                normQ += p_p[c] * p_p[c];
+            }
+        }
+        
+        if (normQ > 1.0f)
+        {
+            float scale = 1.0f / std::sqrt(normQ);
+            
+            for (int e = begin*cn; e < end*cn; ++e)
+            {
+                p_[e] *= scale;
+            }
+        }
+    }
+}
+
+void cds::NonLocalPrimalStep::operator()(cv::Range const &range) const
+{
+    int const cn = channels_;
+    int const cols = graph_.frameSize.width;
+    float factor = 1.0f / (1.0f + tau_*lambda_);
+    float div[4];
+    
+    for (int i = range.start*cols; i < range.end*cols; ++i)
+    {
+        std::fill(div, div + cn, 0.0f);
+        
+        for (int e = graph_.offsets[i]; e < graph_.offsets[i+1]; ++e)
+        {
+            for (int c = 0; c < cn; ++c)
+            {
+                div[c] += graph_.weights[e] * p_[e*cn + c];
+            }
+        }
+        
+        for (int n = graph_.inOffsets[i]; n < graph_.inOffsets[i+1]; ++n)
+        {
+            int e = graph_.inEdges[n];
+            
+            for (int c = 0; c < cn; ++c)
+            {
+                div[c] -= graph_.weights[e] * p_[e*cn + c];
+            }
+        }
+        
+        for (int c = 0; c < cn; ++c)
+        {
+            float previous = u_[i*cn + c];
+            float next = (previous + tau_*div[c] + tau_*lambda_*g_[i*cn + c]) * factor;
+            
+            u_[i*cn + c] = next;
+            ubar_[i*cn + c] = 2.0f*next - previous;
+        }
+    }
+}
+
+void cds::BuildNonLocalGraph(cv::Mat const &g, NonLocalGraph &graph, int neighbors, int searchRadius,
+                             int patchRadius, float h)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(g.depth() == CV_32F && g.channels() <= 4);
+    CV_Assert(neighbors > 0 && searchRadius > 0 && patchRadius >= 0 && h > 0.0f);
+    
+    int const k = neighbors;
+    int const pixels = g.rows * g.cols;
+    
+    // The patches of the border pixels are completed by mirroring
+    cv::Mat padded;
+    cv::copyMakeBorder(g, padded, patchRadius, patchRadius, patchRadius, patchRadius, cv::BORDER_REFLECT);
+    
+    std::vector<float> distances(pixels*k, FLT_MAX);
+    std::vector<int> indices(pixels*k, -1);
+    cv::parallel_for_(cv::Range(0, g.rows), cds::NonLocalSearch(padded, g.size(), k, searchRadius, patchRadius, distances, indices));
+    
+    // Outgoing edges (the window of a small image may hold less than k neighbors)
+    graph.frameSize = g.size();
+    graph.offsets.assign(pixels + 1, 0);
+    graph.neighbors.clear();
+    graph.weights.clear();
+    graph.neighbors.reserve(pixels*k);
+    graph.weights.reserve(pixels*k);
+    
+    float scale = -0.5f / (h*h);
+    
+    for (int i = 0; i < pixels; ++i)
+    {
+        for (int n = i*k; n < (i+1)*k && indices[n] >= 0; ++n)
+        {
+            graph.neighbors.push_back(indices[n]);
+            graph.weights.push_back(std::exp(scale * distances[n]));
+        }
+        
+        graph.offsets[i+1] = (int)graph.neighbors.size();
+    }
+    
+    // Incoming edges, by a counting sort of the edges on their target
+    int const edges = (int)graph.neighbors.size();
+    graph.inOffsets.assign(pixels + 1, 0);
+    
+    for (int e = 0; e < edges; ++e)
+    {
+        ++graph.inOffsets[graph.neighbors[e] + 1];
+    }
+    
+    for (int i = 0; i < pixels; ++i)
+    {
+        graph.inOffsets[i+1] += graph.inOffsets[i];
+    }
+    
+    graph.inEdges.resize(edges);
+    std::vector<int> next(graph.inOffsets.begin(), graph.inOffsets.end() - 1);
+    
+    for (int e = 0; e < edges; ++e)
+    {
+        graph.inEdges[next[graph.neighbors[e]]++] = e;
+    }
+    
+    // |grad_w|^2 is bounded by twice the largest degree of the graph
+    float maxDegree = 0.0f;
+    std::vector<float> degrees(pixels, 0.0f);
+    
+    for (int i = 0; i < pixels; ++i)
+    {
+        for (int e = graph.offsets[i]; e < graph.offsets[i+1]; ++e)
+        {
+            float w = graph.weights[e] * graph.weights[e];
+            degrees[i] += w;
+            degrees[graph.neighbors[e]] += w;
+        }
+    }
+    
+    for (int i = 0; i < pixels; ++i)
+    {
+        maxDegree = MAX(maxDegree, degrees[i]);
+    }
+    
+    graph.normSquared = 2.0f * maxDegree;
+}
+
+void cds::NonLocalTvDiffusion(cv::Mat const &g, NonLocalGraph const &graph, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(g.depth() == CV_32F && g.channels() <= 4);
+    CV_Assert(graph.frameSize == g.size() && lambda > 0.0f);
+    
+    // The steps index the pixels as one flat buffer, so they work on continuous copies (e.g. of ROIs)
+    cv::Mat work;
+    
+    if (u.size() != g.size() || u.type() != g.type())
+    {
+        work = g.clone();
+    }
+    else
+    {
+        work = (u.isContinuous() ? u : u.clone());
+    }
+    
+    cv::Mat data = (g.isContinuous() ? g : g.clone());
+    cv::Mat ubar = work.clone();
+    std::vector<float> p(graph.neighbors.size() * g.channels(), 0.0f);
+    
+    // Numerical parameters
+    float L2 = MAX(graph.normSquared, 1e-6f);
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        cv::parallel_for_(cv::Range(0, g.rows), cds::NonLocalDualStep(graph, ubar.ptr<float>(), g.channels(), sigma, p));
+        cv::parallel_for_(cv::Range(0, g.rows), cds::NonLocalPrimalStep(graph, p, data.ptr<float>(), g.channels(), tau, lambda,
+                                                                         work.ptr<float>(), ubar.ptr<float>()));
+    }
+    
+    if (work.data != u.data)
+    {
+        work.copyTo(u);
+    }
+}
@@ -22,126 +22,1094 @@
 // EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cds/tv/primaldual.hpp>
+#include <cds/tv/tvsolver.hpp>
+#include <cds/tv/primaldualengine.hpp>
 #include <cds/math/prox.hpp>
 #include <cds/math/derivatives.hpp>
+#include <cds/math/poisson.hpp>
+#include <cds/tools/masking.hpp>
 
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
+#include <list>
+#include <vector>
 
-void cds::TvDiffusion(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+#include <pthread.h>
+
+namespace cds
 {
-	if(!g.data)
+    /**
+     * Runs TvInpainting from a given primal and dual state (u, p1, p2), which are updated
+     */
+    void TvInpaintingIterations(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, cv::Mat &p1, cv::Mat &p2, int iterations);
+    
+    /**
+     * Initial state of the solvers: ubar = u and p = grad(u), rounded to the storage.
+     * Only the pixels of region are set.
+     */
+    template <class Storage>
+    void StartPrimalDual(cv::Mat const &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, cv::Rect const &region);
+    
+    /**
+     * Partial sums of the energies measured by TvSolver on a range of bands, one row of sums per image row:
+     * TV(u), the data term of the primal energy and the dual energy.
+     * An empty mask means the ROF model, otherwise inpainting.
+     */
+    template <class Storage>
+    class TvEnergies : public cv::ParallelLoopBody
+    {
+    public:
+        TvEnergies(cv::Mat const &g, cv::Mat const &mask, cv::Mat const &u, cv::Mat const &p1, cv::Mat const &p2,
+                   float lambda, cds::PrimalDualBands const &bands, cv::Mat &sums)
+        : g_(g), mask_(mask), u_(u), p1_(p1), p2_(p2), lambda_(lambda), bands_(bands), sums_(sums) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        cv::Mat const &g_;
+        cv::Mat const &mask_;
+        cv::Mat const &u_;
+        cv::Mat const &p1_;
+        cv::Mat const &p2_;
+        float lambda_;
+        cds::PrimalDualBands const &bands_;
+        cv::Mat &sums_;
+    };
+    
+    /**
+     * Stores the solutions of TvDiffusionPath, a TvPathCallback
+     */
+    void StorePathSolution(int index, float lambda, cv::Mat const &u, void *solutions);
+    
+    /**
+     * Builds the narrow band of TvInpaintingNarrowBand as runs of consecutive pixels, one run being
+     * (row, first column, last column + 1). A pixel belongs to the band when it is missing, or when its
+     * right or lower neighbor is missing.
+     */
+    void BuildNarrowBand(cv::Mat const &mask, std::vector<cv::Vec3i> &runs);
+    
+    /**
+     * Dual ascent + projection onto the unit ball on a range of runs of the narrow band
+     */
+    class NarrowBandDualStep : public cv::ParallelLoopBody
+    {
+    public:
+        NarrowBandDualStep(std::vector<cv::Vec3i> const &runs, cv::Mat const &ubar, cv::Mat &p1, cv::Mat &p2, float sigma)
+        : runs_(runs), ubar_(ubar), p1_(p1), p2_(p2), sigma_(sigma) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        std::vector<cv::Vec3i> const &runs_;
+        cv::Mat const &ubar_;
+        cv::Mat &p1_;
+        cv::Mat &p2_;
+        float sigma_;
+    };
+    
+    /**
+     * Primal descent + over-relaxation on the missing pixels of a range of runs of the narrow band
+     */
+    class NarrowBandPrimalStep : public cv::ParallelLoopBody
+    {
+    public:
+        NarrowBandPrimalStep(std::vector<cv::Vec3i> const &runs, cv::Mat const &mask, cv::Mat &u, cv::Mat &ubar,
+                             cv::Mat const &p1, cv::Mat const &p2, float tau)
+        : runs_(runs), mask_(mask), u_(u), ubar_(ubar), p1_(p1), p2_(p2), tau_(tau) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        std::vector<cv::Vec3i> const &runs_;
+        cv::Mat const &mask_;
+        cv::Mat &u_;
+        cv::Mat &ubar_;
+        cv::Mat const &p1_;
+        cv::Mat const &p2_;
+        float tau_;
+    };
+    
+    /**
+     * Auxiliary buffers of a batch solve. The images are already spread over the threads, so each
+     * one is solved in a single band; the bands are rebuilt when the size or the channels change.
+     */
+    struct TvBatchWorkspace
+    {
+        TvBatchWorkspace() : size(0, 0), channels(0), bands(cv::Size(0, 0), 1, 1) {}
+        
+        cv::Mat ubar;
+        cv::Mat p1;
+        cv::Mat p2;
+        cv::Size size;
+        int channels;
+        cds::PrimalDualBands bands;
+    };
+    
+    /**
+     * Workspaces shared by the threads of a batch: a stripe takes a free one (or a new one) and gives
+     * it back when done, so that there are as many workspaces as concurrent stripes, whatever the
+     * number of stripes.
+     */
+    class TvBatchWorkspaces
+    {
+    public:
+        TvBatchWorkspaces() { pthread_mutex_init(&mutex_, 0); }
+        ~TvBatchWorkspaces() { pthread_mutex_destroy(&mutex_); }
+        
+        TvBatchWorkspace *acquire();
+        void release(TvBatchWorkspace *workspace);
+        
+    private:
+        TvBatchWorkspaces(TvBatchWorkspaces const &);
+        TvBatchWorkspaces &operator=(TvBatchWorkspaces const &);
+        
+        // A list, so that the workspaces do not move when a new one is added
+        std::list<TvBatchWorkspace> workspaces_;
+        std::vector<TvBatchWorkspace *> free_;
+        pthread_mutex_t mutex_;
+    };
+    
+    /**
+     * Solves a range of the images of a batch, one after the other on the calling thread.
+     * An empty mask list means TV-L2 denoising, otherwise TV inpainting.
+     */
+    class TvBatch : public cv::ParallelLoopBody
+    {
+    public:
+        TvBatch(std::vector<cv::Mat> const &g, std::vector<cv::Mat> const &masks, std::vector<cv::Mat> &u, int iterations, float lambda,
+                TvBatchWorkspaces &workspaces)
+        : g_(g), masks_(masks), u_(u), iterations_(iterations), lambda_(lambda), workspaces_(workspaces) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        std::vector<cv::Mat> const &g_;
+        std::vector<cv::Mat> const &masks_;
+        std::vector<cv::Mat> &u_;
+        int iterations_;
+        float lambda_;
+        TvBatchWorkspaces &workspaces_;
+    };
+}
+
+cds::TvSolver::TvSolver()
+: frameSize_(0, 0), type_(-1), storage_(TV_STORAGE_FLOAT32), bands_(0),
+  tolerance_(0.0), checkEvery_(10), callback_(0), userData_(0), interrupt_(0), interruptData_(0), interruptEvery_(0), stats_(),
+  problem_(PROBLEM_ROF), lambda_(0.0f), tau_(0.0f), sigma_(0.0f), resume_(false), resumed_(false), checkpointEvery_(0), checkpointFailed_(false), blockDepth_(1), warmStart_(false), preconditioning_(false),
+  harmonicStart_(false)
+{
+}
+
+cds::TvSolver::TvSolver(cv::Size frameSize, int type, int storage)
+: frameSize_(0, 0), type_(-1), storage_(storage), bands_(0),
+  tolerance_(0.0), checkEvery_(10), callback_(0), userData_(0), interrupt_(0), interruptData_(0), interruptEvery_(0), stats_(),
+  problem_(PROBLEM_ROF), lambda_(0.0f), tau_(0.0f), sigma_(0.0f), resume_(false), resumed_(false), checkpointEvery_(0), checkpointFailed_(false), blockDepth_(1), warmStart_(false), preconditioning_(false),
+  harmonicStart_(false)
+{
+    create(frameSize, type, storage);
+}
+
+cds::TvSolver::~TvSolver()
+{
+    delete bands_;
+}
+
+void cds::TvSolver::create(cv::Size frameSize, int type, int storage)
+{
+    if (bands_ && frameSize == frameSize_ && type == type_ && storage == storage_)
+    {
+        return;
+    }
+    
+    CV_Assert(CV_MAT_DEPTH(type) == CV_32F && CV_MAT_CN(type) <= 4);
+    CV_Assert(storage == TV_STORAGE_FLOAT32 || storage == TV_STORAGE_FLOAT16 || storage == TV_STORAGE_BFLOAT16);
+    
+    frameSize_ = frameSize;
+    type_ = type;
+    storage_ = storage;
+    
+    // 16-bit values are kept in CV_16U matrices
+    int stateType = (storage == TV_STORAGE_FLOAT32 ? type : CV_MAKETYPE(CV_16U, CV_MAT_CN(type)));
+    
+    ubar_.create(frameSize, stateType);
+    p1_.create(frameSize, stateType);
+    p2_.create(frameSize, stateType);
+    
+    delete bands_;
+    bands_ = new cds::PrimalDualBands(frameSize, CV_MAT_CN(type), cv::getNumThreads(), storage, blockDepth_);
+    
+    sums_.create(frameSize.height, 3, CV_64F);
+}
+
+void cds::TvSolver::setStopping(double relativeGap, int checkEvery)
+{
+    CV_Assert(checkEvery > 0);
+    
+    tolerance_ = relativeGap;
+    checkEvery_ = checkEvery;
+}
+
+void cds::TvSolver::setTemporalBlocking(int iterations)
+{
+    CV_Assert(iterations > 0);
+    
+    if (iterations == blockDepth_)
+    {
+        return;
+    }
+    
+    blockDepth_ = iterations;
+    
+    // The bands depend on the depth of the blocks
+    if (bands_)
+    {
+        delete bands_;
+        bands_ = new cds::PrimalDualBands(frameSize_, CV_MAT_CN(type_), cv::getNumThreads(), storage_, blockDepth_);
+    }
+}
+
+int cds::TvSolver::blockLength(int iterations) const
+{
+    int count = MIN(blockDepth_, iterations - stats_.iteration);
+    
+    if (tolerance_ > 0.0 || callback_)
+    {
+        count = MIN(count, checkEvery_ - stats_.iteration % checkEvery_);
+    }
+    
+    if (checkpointEvery_ > 0 && !checkpointFile_.empty())
+    {
+        count = MIN(count, checkpointEvery_ - stats_.iteration % checkpointEvery_);
+    }
+    
+    if (interruptEvery_ > 0 && interrupt_)
+    {
+        count = MIN(count, interruptEvery_ - stats_.iteration % interruptEvery_);
+    }
+    
+    return count;
+}
+
+void cds::TvSolver::setStatsCallback(cds::TvStatsCallback callback, void *userData)
+{
+    callback_ = callback;
+    userData_ = userData;
+}
+
+void cds::TvSolver::setInterruptCallback(cds::TvInterruptCallback callback, void *userData, int every)
+{
+    CV_Assert(every >= 0);
+    
+    interrupt_ = callback;
+    interruptData_ = userData;
+    interruptEvery_ = every;
+}
+
+void cds::TvSolver::restart(cv::Mat const &g, cv::Mat &u, cv::Rect const &region)
+{
+    CV_Assert(bands_ && g.size() == frameSize_ && g.type() == type_ && u.size() == g.size() && u.type() == g.type());
+    
+    cv::Rect area = region & cv::Rect(0, 0, frameSize_.width, frameSize_.height);
+    
+    cv::Mat uArea = u(area);
+    g(area).copyTo(uArea);
+    
+    if (storage_ == TV_STORAGE_FLOAT16)
+    {
+        cds::StartPrimalDual<cds::Float16Storage>(u, ubar_, p1_, p2_, area);
+    }
+    else if (storage_ == TV_STORAGE_BFLOAT16)
+    {
+        cds::StartPrimalDual<cds::BFloat16Storage>(u, ubar_, p1_, p2_, area);
+    }
+    else
+    {
+        cds::StartPrimalDual<cds::Float32Storage>(u, ubar_, p1_, p2_, area);
+    }
+}
+
+/**
+ * Initial point of the solvers: u is kept if it matches g (warm start), otherwise it starts from 0.
+ * The dual variable starts from grad(u).
+ */
+bool cds::TvSolver::start(cv::Mat const &g, cv::Mat &u, int problem, float lambda)
+{
+    // A restored or kept state is only used by the same kind of solve, on frames of the same geometry.
+    // A checkpoint also needs the same parameter, and the operator and prox of a generic solve are unknown.
+    bool sameProblem = problem == problem_ && g.size() == frameSize_ && g.type() == type_
+                    && u.size() == g.size() && u.type() == g.type();
+    bool resumed = resume_ && sameProblem && lambda == lambda_ && problem != PROBLEM_GENERIC;
+    bool warm = warmStart_ && sameProblem;
+    
+    // Whether a loaded checkpoint was used is reported by resumed()
+    resumed_ = resumed;
+    resume_ = false;
+    warmStart_ = false;
+    checkpointFailed_ = false;
+    
+    if (resumed)
+    {
+        return true;
+    }
+    
+    lambda_ = lambda;
+    
+    if (warm)
+    {
+        stats_ = cds::TvStats();
+        return false;
+    }
+    
+    create(g.size(), g.type(), storage_);
+    
+    problem_ = problem;
+    stats_ = cds::TvStats();
+    
+	if (!u.data || u.size() != g.size() || u.type() != g.type())
 	{
-		return;
+		u = cv::Mat::zeros(g.size(), g.type());
 	}
-	
-	if (!u.data)
+    
+    if (storage_ == TV_STORAGE_FLOAT16)
+    {
+        cds::StartPrimalDual<cds::Float16Storage>(u, ubar_, p1_, p2_, cv::Rect(0, 0, u.cols, u.rows));
+        return false;
+    }
+    
+    if (storage_ == TV_STORAGE_BFLOAT16)
+    {
+        cds::StartPrimalDual<cds::BFloat16Storage>(u, ubar_, p1_, p2_, cv::Rect(0, 0, u.cols, u.rows));
+        return false;
+    }
+    
+    // Auxiliary point
+    u.copyTo(ubar_);
+    
+    // Dual variable
+    cds::HorizontalGradientWithForwardScheme(u, p1_);
+    cds::VerticalGradientWithForwardScheme(u, p2_);
+    
+    return false;
+}
+
+template <class Storage>
+void cds::StartPrimalDual(cv::Mat const &u, cv::Mat &ubar, cv::Mat &p1, cv::Mat &p2, cv::Rect const &region)
+{
+    typedef typename Storage::value_type T;
+    
+    int const cn = u.channels();
+    int const valuesPerRow = u.cols * cn;
+    int const first = region.x * cn;
+    int const last = (region.x + region.width) * cn;
+    
+    for (int y = region.y; y < region.y + region.height; ++y)
+    {
+        float const *p_u = u.ptr<float>(y);
+        float const *p_u_next = (y+1 < u.rows ? u.ptr<float>(y+1) : p_u);
+        
+        T *p_ubar = ubar.ptr<T>(y);
+        T *p_p1 = p1.ptr<T>(y);
+        T *p_p2 = p2.ptr<T>(y);
+        
+        // Forward differences, 0 on the last column and row (like the gradient functions)
+        for (int i = first; i < last; ++i)
+        {
+            p_ubar[i] = Storage::store(p_u[i]);
+            p_p1[i] = Storage::store(i + cn < valuesPerRow ? p_u[i+cn] - p_u[i] : 0.0f);
+            p_p2[i] = Storage::store(p_u_next[i] - p_u[i]);
+        }
+    }
+}
+
+bool cds::TvSolver::monitor(cv::Mat const &g, cv::Mat const &mask, cv::Mat const &u, float lambda, int count)
+{
+    stats_.iteration += count;
+    checkpoint(u);
+    
+    if (interrupted(u))
+    {
+        return true;
+    }
+    
+    if ((tolerance_ <= 0.0 && !callback_) || stats_.iteration % checkEvery_ != 0)
+    {
+        return false;
+    }
+    
+    cv::Range allBands(0, bands_->size());
+    
+    if (storage_ == TV_STORAGE_FLOAT16)
+    {
+        cv::parallel_for_(allBands, cds::TvEnergies<cds::Float16Storage>(g, mask, u, p1_, p2_, lambda, *bands_, sums_));
+    }
+    else if (storage_ == TV_STORAGE_BFLOAT16)
+    {
+        cv::parallel_for_(allBands, cds::TvEnergies<cds::BFloat16Storage>(g, mask, u, p1_, p2_, lambda, *bands_, sums_));
+    }
+    else
+    {
+        cv::parallel_for_(allBands, cds::TvEnergies<cds::Float32Storage>(g, mask, u, p1_, p2_, lambda, *bands_, sums_));
+    }
+    
+    // Summed row by row, so that the measure does not depend on the number of bands
+    double tv = 0.0, data = 0.0, dual = 0.0;
+    for (int y = 0; y < sums_.rows; ++y)
+    {
+        double const *p_sums = sums_.ptr<double>(y);
+        tv += p_sums[0];
+        data += p_sums[1];
+        dual += p_sums[2];
+    }
+    
+    stats_.primalEnergy = tv + data;
+    stats_.dualEnergy = dual;
+    stats_.gap = stats_.primalEnergy - stats_.dualEnergy;
+    stats_.relativeGap = stats_.gap / MAX(std::abs(stats_.primalEnergy), DBL_MIN);
+    
+    if (callback_ && !callback_(stats_, userData_))
+    {
+        return true;
+    }
+    
+    return stats_.relativeGap <= tolerance_;
+}
+
+/**
+ * Primal energy: TV(u) + lambda/2 |u - g|^2 (ROF) or TV(u) with u = g on the known pixels (inpainting).
+ * Dual energy, with d = div(p): -<g, d> - |d|^2 / (2 lambda) (ROF), or -<g, d> on the known pixels
+ * - sum of max(d, 0) on the missing ones, since u is constrained to [0, 1] (inpainting).
+ */
+template <class Storage>
+void cds::TvEnergies<Storage>::operator()(cv::Range const &range) const
+{
+    typedef typename Storage::value_type T;
+    
+    int const cn = u_.channels();
+    int const cols = u_.cols;
+    bool const inpainting = (mask_.data != 0);
+    
+    for (int band = range.start; band < range.end; ++band)
+    {
+        for (int y = bands_.begin(band); y < bands_.end(band); ++y)
+        {
+            double tv = 0.0, data = 0.0, dual = 0.0;
+            
+            float const *p_g = g_.ptr<float>(y);
+            float const *p_u = u_.ptr<float>(y);
+            float const *p_u_next = (y+1 < u_.rows ? u_.ptr<float>(y+1) : p_u);
+            float const *p_mask = (inpainting ? mask_.ptr<float>(y) : 0);
+            
+            T const *p_p1 = p1_.ptr<T>(y);
+            T const *p_p2 = p2_.ptr<T>(y);
+            T const *p_p2_prev = (y > 0 ? p2_.ptr<T>(y-1) : 0);
+            
+            for (int x = 0; x < cols; ++x)
+            {
+                double norm2 = 0.0;
+                
+                for (int c = 0; c < cn; ++c)
+                {
+                    int i = x*cn + c;
+                    
+                    // Forward gradient, 0 on the last column and row
+                    float ux = (x+1 < cols ? p_u[i+cn] - p_u[i] : 0.0f);
+                    float uy = p_u_next[i] - p_u[i];
+                    norm2 += ux*ux + uy*uy;
+                    
+                    // Backward divergence, p1 and p2 are 0 on the last column and row
+                    double d = Storage::load(p_p1[i]) + Storage::load(p_p2[i]);
+                    if (x > 0)
+                    {
+                        d -= Storage::load(p_p1[i-cn]);
+                    }
+                    if (y > 0)
+                    {
+                        d -= Storage::load(p_p2_prev[i]);
+                    }
+                    
+                    if (!inpainting)
+                    {
+                        double r = p_u[i] - p_g[i];
+                        data += 0.5 * lambda_ * r * r;
+                        dual -= p_g[i] * d + d * d / (2.0 * lambda_);
+                    }
+                    else if (p_mask[x])
+                    {
+                        dual -= MIN(MAX(0.0f, p_g[i]), 1.0f) * d;
+                    }
+                    else
+                    {
+                        dual -= MAX(d, 0.0);
+                    }
+                }
+                
+                tv += std::sqrt(norm2);
+            }
+            
+            double *p_sums = sums_.ptr<double>(y);
+            p_sums[0] = tv;
+            p_sums[1] = data;
+            p_sums[2] = dual;
+        }
+    }
+}
+
+void cds::TvSolver::solve(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
 	{
-		u = cv::Mat::zeros(g.size(), CV_32FC1);
+		return;
 	}
 	
-    u.create(g.size(), CV_32FC1);
+    start(g, u, PROBLEM_ROF, lambda);
     
-    // Numerical parameters
+    // Numerical parameters: algorithm 1 of [1], like the other policies
     float L2 = 8.0f;
     float tau = 1.0f / std::sqrt(L2);
     float sigma = 1.0f / std::sqrt(L2);
-    float lambdaTau = lambda * tau;
+    tau_ = tau;
+    sigma_ = sigma;
     
-    // Auxiliary points
-    cv::Mat ubar, u_nm1;
-    cv::Mat Du1, Du2;
+    cds::ProxL2Pixel prox(g, lambda, tau);
     
-    // Dual variable
-    cv::Mat p1, p2;
-    p1.create(g.size(), CV_32FC1);
-    p2.create(g.size(), CV_32FC1);
+    while (stats_.iteration < iterations)
+    {
+        int count = blockLength(iterations);
+        cds::PrimalDualIterations(u, ubar_, p1_, p2_, prox, tau, sigma, 1.0f, count, *bands_);
+        
+        if (monitor(g, cv::Mat(), u, lambda, count))
+        {
+            break;
+        }
+    }
+}
+
+void cds::TvSolver::solveAccelerated(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    bool resumed = start(g, u, PROBLEM_ROF_ACCELERATED, lambda);
     
-    u.copyTo(ubar);
-    u.copyTo(u_nm1);
+    // Numerical parameters: the data term is uniformly convex with parameter lambda,
+    // the steps start like algorithm 1 and then follow the schedule of algorithm 2 in [1]
+    float L2 = 8.0f;
+    float gamma = 0.7f * lambda;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / (L2 * tau);
     
-    cds::HorizontalGradientWithForwardScheme(u, p1);
-    cds::VerticalGradientWithForwardScheme(u, p2);
+    if (resumed)
+    {
+        tau = tau_;
+        sigma = sigma_;
+    }
     
-    for (int iter = 0; iter < iterations; ++iter)
+    cds::ProxL2Pixel prox(g, lambda, tau);
+    
+    for (int iter = stats_.iteration; iter < iterations; ++iter)
     {
-        // Update the dual variable
-        cds::HorizontalGradientWithForwardScheme(ubar, Du1);
-        p1 += sigma * Du1;
+        float theta = 1.0f / std::sqrt(1.0f + 2.0f * gamma * tau);
         
-        cds::VerticalGradientWithForwardScheme(ubar, Du2);
-        p2 += sigma * Du2;
+        prox.setTau(tau);
+        cds::PrimalDualIteration(u, ubar_, p1_, p2_, prox, tau, sigma, theta, *bands_);
         
-		cds::ProxLinfBall(p1, p2);
+        tau *= theta;
+        sigma /= theta;
+        tau_ = tau;
+        sigma_ = sigma;
+        
+        if (monitor(g, cv::Mat(), u, lambda, 1))
+        {
+            break;
+        }
+    }
+}
 
-        // Update the solution
-        cds::DivergenceWithBackwardScheme(p1, p2, u);
-        u *= tau;
-        u += u_nm1;
-        cds::ProxL2(u, g, lambda, tau);
+void cds::TvSolver::solvePath(cv::Mat const &g, std::vector<float> const &lambdas, cv::Mat &u, int iterations,
+                              cds::TvPathCallback callback, void *userData)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    for (size_t k = 0; k < lambdas.size(); ++k)
+    {
+        // Warm start: the next solve keeps u, ubar and p
+        warmStart_ = (k > 0);
+        
+        solveAccelerated(g, u, iterations, lambdas[k]);
         
-        // Update the auxiliary point
-        ubar = 2.0f * u - u_nm1;
-        u.copyTo(u_nm1);
+        if (callback)
+        {
+            callback((int)k, lambdas[k], u, userData);
+        }
     }
 }
 
-void cds::TvInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations)
+void cds::TvSolver::solve(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations)
 {
 	if(!g.data || !mask.data)
 	{
 		return;
 	}
 	
-	if (!u.data)
+    // A cold start from 0 is replaced by the harmonic fill of the holes
+    if (harmonicStart_ && (u.size() != g.size() || u.type() != g.type()))
+    {
+        cds::HarmonicInpainting(g, mask, u);
+    }
+    
+    start(g, u, preconditioning_ ? PROBLEM_INPAINTING_PRECONDITIONED : PROBLEM_INPAINTING, 0.0f);
+    
+    // Numerical parameters, the diagonal steps are scaled by the preconditioned operator
+    float L2 = (preconditioning_ ? 1.0f : 8.0f);
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    tau_ = tau;
+    sigma_ = sigma;
+    
+    cds::ProxInpaintingPixel prox(g, mask);
+    
+    while (stats_.iteration < iterations)
+    {
+        int count = blockLength(iterations);
+        
+        if (preconditioning_)
+        {
+            // The steps are computed from the mask on the fly, so the operator is cheap to build
+            cds::PreconditionedTvOperator op(mask, g.size());
+            cds::PrimalDualIterations(u, ubar_, p1_, p2_, op, cds::ProjectionL2Ball(), prox, tau, sigma, 1.0f, count, *bands_);
+        }
+        else
+        {
+            cds::PrimalDualIterations(u, ubar_, p1_, p2_, prox, tau, sigma, 1.0f, count, *bands_);
+        }
+        
+        if (monitor(g, mask, u, 0.0f, count))
+        {
+            break;
+        }
+    }
+}
+
+void cds::TvDiffusion(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
 	{
-		u = cv::Mat::zeros(g.size(), CV_32FC1);
+		return;
 	}
 	
-    u.create(g.size(), CV_32FC1);
+    cds::TvSolver solver(g.size(), g.type());
+    solver.solve(g, u, iterations, lambda);
+}
+
+void cds::TvDiffusionAccelerated(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    cds::TvSolver solver(g.size(), g.type());
+    solver.solveAccelerated(g, u, iterations, lambda);
+}
+
+void cds::StorePathSolution(int index, float, cv::Mat const &u, void *solutions)
+{
+    u.copyTo((*static_cast<std::vector<cv::Mat> *>(solutions))[index]);
+}
+
+void cds::TvDiffusionPath(cv::Mat const &g, std::vector<float> const &lambdas, std::vector<cv::Mat> &u, int iterations)
+{
+    u.resize(lambdas.size());
     
-    cv::Mat invMask;
-    cv::absdiff(mask, cv::Scalar::all(-1), invMask);
+    cv::Mat current;
+    cds::TvSolver solver;
+    solver.solvePath(g, lambdas, current, iterations, cds::StorePathSolution, &u);
+}
+
+void cds::TvL1Denoising(cv::Mat const &g, cv::Mat &u, int iterations, float lambda)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    cds::TvSolver solver(g.size(), g.type());
+    solver.solve(g, u, iterations, cds::TvOperator(), cds::ProjectionL2Ball(), cds::ProxL1Pixel(g, lambda, 0.0f));
+}
+
+void cds::HuberTvDiffusion(cv::Mat const &g, cv::Mat &u, int iterations, float lambda, float alpha)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    cds::TvSolver solver(g.size(), g.type());
+    solver.solve(g, u, iterations, cds::TvOperator(), cds::HuberProjection(alpha), cds::ProxL2Pixel(g, lambda, 0.0f));
+}
+
+void cds::TvInpainting(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations)
+{
+	if(!g.data || !mask.data)
+	{
+		return;
+	}
+	
+    cds::TvSolver solver(g.size(), g.type());
+    solver.solve(g, mask, u, iterations);
+}
+
+void cds::TvInpaintingIterations(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, cv::Mat &p1, cv::Mat &p2, int iterations)
+{
+    // Numerical parameters
+    float L2 = 8.0f;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    
+    // Auxiliary point
+    cv::Mat ubar;
+    u.copyTo(ubar);
+    
+    cds::ProxInpaintingPixel prox(g, mask);
+    cds::PrimalDualBands bands(g.size(), g.channels(), cv::getNumThreads());
+    
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        cds::PrimalDualIteration(u, ubar, p1, p2, prox, tau, sigma, 1.0f, bands);
+    }
+}
+
+void cds::TvInpaintingNarrowBand(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations)
+{
+	if(!g.data || !mask.data)
+	{
+		return;
+	}
+	
+	CV_Assert(g.depth() == CV_32F && g.channels() <= 4);
+	
+	if (!u.data || u.size() != g.size() || u.type() != g.type())
+	{
+		u = cv::Mat::zeros(g.size(), g.type());
+	}
     
     // Numerical parameters
     float L2 = 8.0f;
     float tau = 1.0f / std::sqrt(L2);
     float sigma = 1.0f / std::sqrt(L2);
     
-    // Auxiliary points
-    cv::Mat ubar, u_nm1;
-    cv::Mat Du1, Du2;
+    // The known pixels are fixed once and for all, like ProxInpaintingPixel would do at each iteration
+    int const cn = g.channels();
     
-    // Dual variable
-    cv::Mat p1, p2;
-    p1.create(g.size(), CV_32FC1);
-    p2.create(g.size(), CV_32FC1);
+    for (int y = 0; y < g.rows; ++y)
+    {
+        float const *p_g = g.ptr<float>(y);
+        float const *p_mask = mask.ptr<float>(y);
+        float *p_u = u.ptr<float>(y);
+        
+        for (int x = 0; x < g.cols; ++x)
+        {
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                p_u[i] = MIN(MAX(0.0f, (p_mask[x] ? p_g[i] : p_u[i])), 1.0f);
+            }
+        }
+    }
     
+    // Auxiliary point
+    cv::Mat ubar;
     u.copyTo(ubar);
-    u.copyTo(u_nm1);
     
-    cds::HorizontalGradientWithForwardScheme(u, p1);
-    cds::VerticalGradientWithForwardScheme(u, p2);
+    // Dual variable, only read and written on the band
+    cv::Mat p1 = cv::Mat::zeros(g.size(), g.type());
+    cv::Mat p2 = cv::Mat::zeros(g.size(), g.type());
+    
+    std::vector<cv::Vec3i> runs;
+    cds::BuildNarrowBand(mask, runs);
+    
+    if (runs.empty())
+    {
+        return;
+    }
+    
+    cv::Range allRuns(0, (int)runs.size());
     
     for (int iter = 0; iter < iterations; ++iter)
     {
-        // Update the dual variable
-        cds::HorizontalGradientWithForwardScheme(ubar, Du1);
-        p1 += sigma * Du1;
+        cv::parallel_for_(allRuns, cds::NarrowBandDualStep(runs, ubar, p1, p2, sigma));
+        cv::parallel_for_(allRuns, cds::NarrowBandPrimalStep(runs, mask, u, ubar, p1, p2, tau));
+    }
+}
+
+void cds::BuildNarrowBand(cv::Mat const &mask, std::vector<cv::Vec3i> &runs)
+{
+    runs.clear();
+    
+    for (int y = 0; y < mask.rows; ++y)
+    {
+        float const *p_mask = mask.ptr<float>(y);
+        float const *p_mask_next = (y+1 < mask.rows ? mask.ptr<float>(y+1) : p_mask);
+        
+        int begin = -1;
+        
+        for (int x = 0; x < mask.cols; ++x)
+        {
+            bool inBand = (!p_mask[x] || !p_mask_next[x] || (x+1 < mask.cols && !p_mask[x+1]));
+            
+            if (inBand && begin < 0)
+            {
+                begin = x;
+            }
+            else if (!inBand && begin >= 0)
+            {
+                runs.push_back(cv::Vec3i(y, begin, x));
+                begin = -1;
+            }
+        }
+        
+        if (begin >= 0)
+        {
+            runs.push_back(cv::Vec3i(y, begin, mask.cols));
+        }
+    }
+}
+
+void cds::NarrowBandDualStep::operator()(cv::Range const &range) const
+{
+    int const rows = ubar_.rows;
+    int const cols = ubar_.cols;
+    int const cn = ubar_.channels();
+    
+    for (int r = range.start; r < range.end; ++r)
+    {
+        int y = runs_[r][0];
+        
+        // p1 (resp. p2) vanishes on the last column (resp. row)
+        bool hasNextRow = (y+1 < rows);
+        
+        float const *p_ubar = ubar_.ptr<float>(y);
+        float const *p_ubar_next = (hasNextRow ? ubar_.ptr<float>(y+1) : p_ubar);
+        float *p_p1 = p1_.ptr<float>(y);
+        float *p_p2 = p2_.ptr<float>(y);
+        
+        for (int x = runs_[r][1]; x < runs_[r][2]; ++x)
+        {
+            bool hasNextCol = (x+1 < cols);
+            float normQ = 0.0f;
+            
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                p_p1[i] = (hasNextCol ? p_p1[i] + sigma_ * (p_ubar[i+cn] - p_ubar[i]) : 0.0f);
+                p_p2[i] = (hasNextRow ? p_p2[i] + sigma_ * (p_ubar_next[i] - p_ubar[i]) : 0.0f);
+                
+                normQ += p_p1[i]*p_p1[i] + p_p2[i]*p_p2[i];
+            }
+            
+            normQ = MAX(1.0f, std::sqrt(normQ));
+            
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                p_p1[i] /= normQ;
+                p_p2[i] /= normQ;
+            }
+        }
+    }
+}
+
+void cds::NarrowBandPrimalStep::operator()(cv::Range const &range) const
+{
+    int const cn = u_.channels();
+    
+    for (int r = range.start; r < range.end; ++r)
+    {
+        int y = runs_[r][0];
+        
+        float const *p_mask = mask_.ptr<float>(y);
+        float const *p_p1 = p1_.ptr<float>(y);
+        float const *p_p2 = p2_.ptr<float>(y);
+        float const *p_p2_prev = (y > 0 ? p2_.ptr<float>(y-1) : p_p2);
+        float const hasPrevRow = (y > 0 ? 1.0f : 0.0f);
+        
+        float *p_u = u_.ptr<float>(y);
+        float *p_ubar = ubar_.ptr<float>(y);
+        
+        for (int x = runs_[r][1]; x < runs_[r][2]; ++x)
+        {
+            // The known pixels of the band only carry the dual variable
+            if (p_mask[x])
+            {
+                continue;
+            }
+            
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                // Divergence with the backward scheme
+                float divP = (p_p1[i] - (x > 0 ? p_p1[i-cn] : 0.0f)) + (p_p2[i] - hasPrevRow * p_p2_prev[i]);
+                
+                float u_old = p_u[i];
+                float u_new = MIN(MAX(0.0f, u_old + tau_ * divP), 1.0f);
+                
+                p_u[i] = u_new;
+                p_ubar[i] = 2.0f * u_new - u_old;
+            }
+        }
+    }
+}
+
+void cds::TvInpaintingMultiscale(cv::Mat const &g, cv::Mat const &mask, cv::Mat &u, int iterations, int levels, int fineIterations)
+{
+	if(!g.data || !mask.data)
+	{
+		return;
+	}
+    
+    // Pyramid of observations, level 0 is the full resolution
+    std::vector<cv::Mat> gPyramid(1, g);
+    std::vector<cv::Mat> maskPyramid(1, mask);
+    
+    while ((int)gPyramid.size() < levels && gPyramid.back().rows > 1 && gPyramid.back().cols > 1)
+    {
+        cv::Mat coarseG, coarseMask;
+        cds::DownsampleMaskedImage(gPyramid.back(), maskPyramid.back(), coarseG, coarseMask);
+        
+        gPyramid.push_back(coarseG);
+        maskPyramid.push_back(coarseMask);
+    }
+    
+    // Coarse to fine: the primal and dual variables of a level initialize the next one
+    int coarsest = (int)gPyramid.size() - 1;
+    
+    cv::Mat uLevel = cv::Mat::zeros(gPyramid[coarsest].size(), g.type());
+    cv::Mat p1 = cv::Mat::zeros(gPyramid[coarsest].size(), g.type());
+    cv::Mat p2 = cv::Mat::zeros(gPyramid[coarsest].size(), g.type());
+    
+    for (int level = coarsest; level >= 0; --level)
+    {
+        cv::Size levelSize = gPyramid[level].size();
+        
+        if (level < coarsest)
+        {
+            cv::resize(uLevel, uLevel, levelSize, 0, 0, cv::INTER_LINEAR);
+            cv::resize(p1, p1, levelSize, 0, 0, cv::INTER_LINEAR);
+            cv::resize(p2, p2, levelSize, 0, 0, cv::INTER_LINEAR);
+        }
+        
+        cds::TvInpaintingIterations(gPyramid[level], maskPyramid[level], uLevel, p1, p2, (level > 0 ? iterations : fineIterations));
+    }
+    
+    u = uLevel;
+}
+
+cds::TvBatchWorkspace *cds::TvBatchWorkspaces::acquire()
+{
+    pthread_mutex_lock(&mutex_);
+    
+    if (free_.empty())
+    {
+        workspaces_.push_back(cds::TvBatchWorkspace());
+        free_.push_back(&workspaces_.back());
+    }
+    
+    cds::TvBatchWorkspace *workspace = free_.back();
+    free_.pop_back();
+    
+    pthread_mutex_unlock(&mutex_);
+    return workspace;
+}
+
+void cds::TvBatchWorkspaces::release(cds::TvBatchWorkspace *workspace)
+{
+    pthread_mutex_lock(&mutex_);
+    free_.push_back(workspace);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void cds::TvBatch::operator()(cv::Range const &range) const
+{
+    float L2 = 8.0f;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    
+    cds::TvBatchWorkspace *workspace = workspaces_.acquire();
+    cv::Mat &ubar = workspace->ubar;
+    cv::Mat &p1 = workspace->p1;
+    cv::Mat &p2 = workspace->p2;
+    cds::PrimalDualBands &bands = workspace->bands;
+    
+    for (int i = range.start; i < range.end; ++i)
+    {
+        cv::Mat const &g = g_[i];
+        cv::Mat &u = u_[i];
         
-        cds::VerticalGradientWithForwardScheme(ubar, Du2);
-        p2 += sigma * Du2;
+        if (!g.data || (!masks_.empty() && !masks_[i].data))
+        {
+            continue;
+        }
         
-		cds::ProxLinfBall(p1, p2);
+        u.create(g.size(), g.type());
+        u.setTo(cv::Scalar::all(0));
         
-        // Update the solution
-        cds::DivergenceWithBackwardScheme(p1, p2, u);
-        u *= tau;
-        u += u_nm1;
-        cds::ProxL2Inpainting(u, g, mask);
-        cds::ProxInterval(u, 0.0, 1.0);
+        u.copyTo(ubar);
+        p1.create(g.size(), g.type());
+        p1.setTo(cv::Scalar::all(0));
+        p2.create(g.size(), g.type());
+        p2.setTo(cv::Scalar::all(0));
         
-        // Update the auxiliary point
-        ubar = 2.0f * u - u_nm1;
-        u.copyTo(u_nm1);
+        if (g.size() != workspace->size || g.channels() != workspace->channels)
+        {
+            workspace->size = g.size();
+            workspace->channels = g.channels();
+            bands = cds::PrimalDualBands(g.size(), g.channels(), 1);
+        }
+        
+        if (masks_.empty())
+        {
+            cds::ProxL2Pixel prox(g, lambda_, tau);
+            
+            for (int iter = 0; iter < iterations_; ++iter)
+            {
+                cds::PrimalDualIteration(u, ubar, p1, p2, prox, tau, sigma, 1.0f, bands);
+            }
+        }
+        else
+        {
+            cds::ProxInpaintingPixel prox(g, masks_[i]);
+            
+            for (int iter = 0; iter < iterations_; ++iter)
+            {
+                cds::PrimalDualIteration(u, ubar, p1, p2, prox, tau, sigma, 1.0f, bands);
+            }
+        }
     }
+    
+    workspaces_.release(workspace);
+}
+
+void cds::TvDiffusionBatch(std::vector<cv::Mat> const &g, std::vector<cv::Mat> &u, int iterations, float lambda)
+{
+    std::vector<cv::Mat> noMasks;
+    u.resize(g.size());
+    
+    // One stripe per image, so that the threads balance images of different sizes
+    cds::TvBatchWorkspaces workspaces;
+    cv::parallel_for_(cv::Range(0, (int)g.size()), cds::TvBatch(g, noMasks, u, iterations, lambda, workspaces), (double)g.size());
+}
+
+void cds::TvInpaintingBatch(std::vector<cv::Mat> const &g, std::vector<cv::Mat> const &masks, std::vector<cv::Mat> &u, int iterations)
+{
+    CV_Assert(g.size() == masks.size());
+    
+    u.resize(g.size());
+    
+    // One stripe per image, so that the threads balance images of different sizes
+    cds::TvBatchWorkspaces workspaces;
+    cv::parallel_for_(cv::Range(0, (int)g.size()), cds::TvBatch(g, masks, u, iterations, 0.0f, workspaces), (double)g.size());
 }
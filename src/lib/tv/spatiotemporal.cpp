@@ -0,0 +1,259 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/spatiotemporal.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace cds
+{
+    /**
+     * Dual ascent + projection onto the unit ball, for a range of rows of the window.
+     * Row index r covers row r % rows of the frame t = r / rows (in time order).
+     */
+    class SpatioTemporalDualStep : public cv::ParallelLoopBody
+    {
+    public:
+        SpatioTemporalDualStep(std::vector<cv::Mat> const &ubar, std::vector<cv::Mat> &p1, std::vector<cv::Mat> &p2, std::vector<cv::Mat> &p3,
+                               int oldest, int count, float sigma, float temporalWeight)
+        : ubar_(ubar), p1_(p1), p2_(p2), p3_(p3), oldest_(oldest), count_(count), sigma_(sigma), temporalWeight_(temporalWeight) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        std::vector<cv::Mat> const &ubar_;
+        std::vector<cv::Mat> &p1_;
+        std::vector<cv::Mat> &p2_;
+        std::vector<cv::Mat> &p3_;
+        int oldest_;
+        int count_;
+        float sigma_;
+        float temporalWeight_;
+    };
+    
+    /**
+     * Primal descent (pointwise ProxL2) + over-relaxation, for a range of rows of the window
+     */
+    class SpatioTemporalPrimalStep : public cv::ParallelLoopBody
+    {
+    public:
+        SpatioTemporalPrimalStep(std::vector<cv::Mat> const &g, std::vector<cv::Mat> &u, std::vector<cv::Mat> &ubar,
+                                 std::vector<cv::Mat> const &p1, std::vector<cv::Mat> const &p2, std::vector<cv::Mat> const &p3,
+                                 int oldest, int count, float tau, float lambda, float temporalWeight)
+        : g_(g), u_(u), ubar_(ubar), p1_(p1), p2_(p2), p3_(p3), oldest_(oldest), count_(count),
+          tau_(tau), lambda_(lambda), temporalWeight_(temporalWeight) {}
+        
+        void operator()(cv::Range const &range) const;
+        
+    private:
+        std::vector<cv::Mat> const &g_;
+        std::vector<cv::Mat> &u_;
+        std::vector<cv::Mat> &ubar_;
+        std::vector<cv::Mat> const &p1_;
+        std::vector<cv::Mat> const &p2_;
+        std::vector<cv::Mat> const &p3_;
+        int oldest_;
+        int count_;
+        float tau_;
+        float lambda_;
+        float temporalWeight_;
+    };
+}
+
+cds::SpatioTemporalTvDiffusion::SpatioTemporalTvDiffusion(int windowSize, int iterations, float lambda, float temporalWeight)
+: windowSize_(MAX(1, windowSize)), iterations_(iterations), lambda_(lambda), temporalWeight_(temporalWeight), oldest_(0), count_(0)
+{
+    g_.resize(windowSize_);
+    u_.resize(windowSize_);
+    ubar_.resize(windowSize_);
+    p1_.resize(windowSize_);
+    p2_.resize(windowSize_);
+    p3_.resize(windowSize_);
+}
+
+void cds::SpatioTemporalTvDiffusion::reset()
+{
+    oldest_ = 0;
+    count_ = 0;
+}
+
+void cds::SpatioTemporalTvDiffusion::operator()(cv::Mat const &frame, cv::Mat &u)
+{
+    if (!frame.data)
+    {
+        return;
+    }
+    
+    CV_Assert(frame.depth() == CV_32F && frame.channels() <= 4);
+    
+    if (count_ > 0 && (g_[oldest_].size() != frame.size() || g_[oldest_].type() != frame.type()))
+    {
+        reset();
+    }
+    
+    // The new frame takes the slot of the oldest one once the window is full
+    int slot = (oldest_ + count_) % windowSize_;
+    
+    if (count_ < windowSize_)
+    {
+        ++count_;
+    }
+    else
+    {
+        oldest_ = (oldest_ + 1) % windowSize_;
+    }
+    
+    // The buffers of a slot are allocated once, then reused
+    frame.copyTo(g_[slot]);
+    frame.copyTo(u_[slot]);
+    frame.copyTo(ubar_[slot]);
+    
+    p1_[slot].create(frame.size(), frame.type());
+    p1_[slot].setTo(cv::Scalar::all(0));
+    p2_[slot].create(frame.size(), frame.type());
+    p2_[slot].setTo(cv::Scalar::all(0));
+    p3_[slot].create(frame.size(), frame.type());
+    p3_[slot].setTo(cv::Scalar::all(0));
+    
+    // Numerical parameters: |grad|^2 <= 8 + 4*w^2 with the temporal derivative
+    float L2 = 8.0f + 4.0f * temporalWeight_ * temporalWeight_;
+    float tau = 1.0f / std::sqrt(L2);
+    float sigma = 1.0f / std::sqrt(L2);
+    
+    for (int iter = 0; iter < iterations_; ++iter)
+    {
+        iterate(tau, sigma);
+    }
+    
+    u_[slot].copyTo(u);
+}
+
+void cds::SpatioTemporalTvDiffusion::iterate(float tau, float sigma)
+{
+    cv::Range allRows(0, count_ * g_[oldest_].rows);
+    
+    cv::parallel_for_(allRows, cds::SpatioTemporalDualStep(ubar_, p1_, p2_, p3_, oldest_, count_, sigma, temporalWeight_));
+    cv::parallel_for_(allRows, cds::SpatioTemporalPrimalStep(g_, u_, ubar_, p1_, p2_, p3_, oldest_, count_, tau, lambda_, temporalWeight_));
+}
+
+void cds::SpatioTemporalDualStep::operator()(cv::Range const &range) const
+{
+    int const windowSize = (int)ubar_.size();
+    int const rows = ubar_[oldest_].rows;
+    int const cols = ubar_[oldest_].cols;
+    int const cn = ubar_[oldest_].channels();
+    
+    for (int r = range.start; r < range.end; ++r)
+    {
+        int t = r / rows;
+        int y = r % rows;
+        
+        int slot = (oldest_ + t) % windowSize;
+        int nextSlot = (slot + 1) % windowSize;
+        
+        // p2 (resp. p3) vanishes on the last row (resp. the newest frame)
+        bool hasNextRow = (y+1 < rows);
+        bool hasNextFrame = (t+1 < count_);
+        
+        float const *p_ubar = ubar_[slot].ptr<float>(y);
+        float const *p_ubar_down = (hasNextRow ? ubar_[slot].ptr<float>(y+1) : p_ubar);
+        float const *p_ubar_next = (hasNextFrame ? ubar_[nextSlot].ptr<float>(y) : p_ubar);
+        
+        float *p_p1 = p1_[slot].ptr<float>(y);
+        float *p_p2 = p2_[slot].ptr<float>(y);
+        float *p_p3 = p3_[slot].ptr<float>(y);
+        
+        for (int x = 0; x < cols; ++x)
+        {
+            bool hasNextCol = (x+1 < cols);
+            float normQ = 0.0f;
+            
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                p_p1[i] = (hasNextCol ? p_p1[i] + sigma_ * (p_ubar[i+cn] - p_ubar[i]) : 0.0f);
+                p_p2[i] = (hasNextRow ? p_p2[i] + sigma_ * (p_ubar_down[i] - p_ubar[i]) : 0.0f);
+                p_p3[i] = (hasNextFrame ? p_p3[i] + sigma_ * temporalWeight_ * (p_ubar_next[i] - p_ubar[i]) : 0.0f);
+                
+                normQ += p_p1[i]*p_p1[i] + p_p2[i]*p_p2[i] + p_p3[i]*p_p3[i];
+            }
+            
+            normQ = MAX(1.0f, std::sqrt(normQ));
+            
+            for (int i = x*cn; i < (x+1)*cn; ++i)
+            {
+                p_p1[i] /= normQ;
+                p_p2[i] /= normQ;
+                p_p3[i] /= normQ;
+            }
+        }
+    }
+}
+
+void cds::SpatioTemporalPrimalStep::operator()(cv::Range const &range) const
+{
+    int const windowSize = (int)u_.size();
+    int const rows = u_[oldest_].rows;
+    int const valuesPerRow = u_[oldest_].cols * u_[oldest_].channels();
+    int const cn = u_[oldest_].channels();
+    
+    float const lambdaTau = lambda_ * tau_;
+    float const scale = 1.0f / (1.0f + lambdaTau);
+    
+    for (int r = range.start; r < range.end; ++r)
+    {
+        int t = r / rows;
+        int y = r % rows;
+        
+        int slot = (oldest_ + t) % windowSize;
+        int prevSlot = (slot + windowSize - 1) % windowSize;
+        
+        // The dual variable is 0 before the first column, row and frame
+        float const hasPrevRow = (y > 0 ? 1.0f : 0.0f);
+        float const hasPrevFrame = (t > 0 ? temporalWeight_ : 0.0f);
+        
+        float const *p_g = g_[slot].ptr<float>(y);
+        float const *p_p1 = p1_[slot].ptr<float>(y);
+        float const *p_p2 = p2_[slot].ptr<float>(y);
+        float const *p_p3 = p3_[slot].ptr<float>(y);
+        float const *p_p2_up = (y > 0 ? p2_[slot].ptr<float>(y-1) : p_p2);
+        float const *p_p3_prev = (t > 0 ? p3_[prevSlot].ptr<float>(y) : p_p3);
+        
+        float *p_u = u_[slot].ptr<float>(y);
+        float *p_ubar = ubar_[slot].ptr<float>(y);
+        
+        for (int i = 0; i < valuesPerRow; ++i)
+        {
+            // Divergence with the backward scheme
+            float divP = (p_p1[i] - (i >= cn ? p_p1[i-cn] : 0.0f))
+                       + (p_p2[i] - hasPrevRow * p_p2_up[i])
+                       + (temporalWeight_ * p_p3[i] - hasPrevFrame * p_p3_prev[i]);
+            
+            float u_old = p_u[i];
+            float u_new = (u_old + tau_ * divP + lambdaTau * p_g[i]) * scale;
+            
+            p_u[i] = u_new;
+            p_ubar[i] = 2.0f * u_new - u_old;
+        }
+    }
+}
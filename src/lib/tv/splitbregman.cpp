@@ -0,0 +1,299 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/splitbregman.hpp>
+#include <cds/math/derivatives.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace cds
+{
+    void SplitBregmanDenominator(cv::Size transformSize, int boundary, float lambda, float mu, cv::Mat &denominator);
+    void SolveSplitBregmanLinear(cv::Mat const &rhs, cv::Mat const &denominator, int boundary, cv::Mat &u);
+    void SplitBregmanGradient(cv::Mat const &X, int boundary, cv::Mat &D1, cv::Mat &D2);
+    void SplitBregmanDivergence(cv::Mat const &X1, cv::Mat const &X2, int boundary, cv::Mat &divX);
+    void SplitBregmanShrinkage(cv::Mat const &D1, cv::Mat const &D2, float threshold, cv::Mat &B1, cv::Mat &B2, cv::Mat &W1, cv::Mat &W2);
+}
+
+void cds::TvDiffusionSplitBregman(cv::Mat const &g, cv::Mat &u, int iterations, float lambda, float mu, int boundary)
+{
+	if(!g.data)
+	{
+		return;
+	}
+	
+    CV_Assert(CV_MAT_DEPTH(g.type()) == CV_32F && g.channels() <= 4);
+    CV_Assert(boundary == TV_BOUNDARY_NEUMANN || boundary == TV_BOUNDARY_PERIODIC);
+    CV_Assert(lambda > 0.0f);
+    
+    if (mu <= 0.0f)
+    {
+        mu = 10.0f;
+    }
+    
+	if (!u.data || u.size() != g.size() || u.type() != g.type())
+	{
+		u = g.clone();
+	}
+    
+    // cv::dct only takes even sizes: an odd dimension is mirrored, which keeps the Neumann conditions
+    cv::Size transformSize = g.size();
+    
+    if (boundary == TV_BOUNDARY_NEUMANN)
+    {
+        if (transformSize.width > 1 && transformSize.width % 2)
+        {
+            transformSize.width *= 2;
+        }
+        
+        if (transformSize.height > 1 && transformSize.height % 2)
+        {
+            transformSize.height *= 2;
+        }
+    }
+    
+    cv::Mat denominator;
+    cds::SplitBregmanDenominator(transformSize, boundary, lambda, mu, denominator);
+    
+    // B is the Bregman variable, W = d - b
+    cv::Mat B1 = cv::Mat::zeros(g.size(), g.type());
+    cv::Mat B2 = cv::Mat::zeros(g.size(), g.type());
+    cv::Mat W1(g.size(), g.type());
+    cv::Mat W2(g.size(), g.type());
+    
+    cv::Mat D1, D2, divW, rhs;
+    
+    for (int i = 0; i < iterations; ++i)
+    {
+        // d and b from the current u
+        cds::SplitBregmanGradient(u, boundary, D1, D2);
+        cds::SplitBregmanShrinkage(D1, D2, 1.0f / mu, B1, B2, W1, W2);
+        
+        // Exact linear step
+        cds::SplitBregmanDivergence(W1, W2, boundary, divW);
+        rhs = lambda * g - mu * divW;
+        cds::SolveSplitBregmanLinear(rhs, denominator, boundary, u);
+    }
+}
+
+/**
+ * Inverse of the eigenvalues of lambda - mu Laplacian in the transformed domain.
+ * The eigenvalues of the 1D Laplacian are 4 sin^2(pi k/2n) for the DCT and 4 sin^2(pi k/n) for the DFT.
+ * For the DFT, the values are duplicated in 2 channels, to scale the complex spectrum.
+ */
+void cds::SplitBregmanDenominator(cv::Size transformSize, int boundary, float lambda, float mu, cv::Mat &denominator)
+{
+    double period = (boundary == TV_BOUNDARY_NEUMANN ? 2.0 : 1.0);
+    
+    std::vector<double> eigenX(transformSize.width);
+    std::vector<double> eigenY(transformSize.height);
+    
+    for (int x = 0; x < transformSize.width; ++x)
+    {
+        double s = std::sin(CV_PI * x / (period * transformSize.width));
+        eigenX[x] = 4.0 * s * s;
+    }
+    
+    for (int y = 0; y < transformSize.height; ++y)
+    {
+        double s = std::sin(CV_PI * y / (period * transformSize.height));
+        eigenY[y] = 4.0 * s * s;
+    }
+    
+    int channels = (boundary == TV_BOUNDARY_NEUMANN ? 1 : 2);
+    denominator.create(transformSize, CV_MAKETYPE(CV_32F, channels));
+    
+    for (int y = 0; y < transformSize.height; ++y)
+    {
+        float *p_den = denominator.ptr<float>(y);
+        
+        for (int x = 0; x < transformSize.width; ++x)
+        {
+            float value = (float)(1.0 / (lambda + mu * (eigenX[x] + eigenY[y])));
+            
+            for (int c = 0; c < channels; ++c, ++p_den)
+            {
+                *p_den = value;
+            }
+        }
+    }
+}
+
+void cds::SolveSplitBregmanLinear(cv::Mat const &rhs, cv::Mat const &denominator, int boundary, cv::Mat &u)
+{
+    std::vector<cv::Mat> planes;
+    cv::split(rhs, planes);
+    
+    cv::Mat spectrum;
+    
+    for (size_t c = 0; c < planes.size(); ++c)
+    {
+        if (boundary == TV_BOUNDARY_NEUMANN)
+        {
+            cv::Mat extended = planes[c];
+            
+            if (denominator.size() != rhs.size())
+            {
+                cv::copyMakeBorder(planes[c], extended, 0, denominator.rows - rhs.rows, 0, denominator.cols - rhs.cols, cv::BORDER_REFLECT);
+            }
+            
+            cv::dct(extended, spectrum);
+            cv::multiply(spectrum, denominator, spectrum);
+            cv::idct(spectrum, extended);
+            
+            planes[c] = extended(cv::Rect(0, 0, rhs.cols, rhs.rows)).clone();
+        }
+        else
+        {
+            cv::dft(planes[c], spectrum, cv::DFT_COMPLEX_OUTPUT);
+            cv::multiply(spectrum, denominator, spectrum);
+            cv::idft(spectrum, planes[c], cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+        }
+    }
+    
+    cv::merge(planes, u);
+}
+
+void cds::SplitBregmanGradient(cv::Mat const &X, int boundary, cv::Mat &D1, cv::Mat &D2)
+{
+    if (boundary == TV_BOUNDARY_NEUMANN)
+    {
+        cds::HorizontalGradientWithForwardScheme(X, D1);
+        cds::VerticalGradientWithForwardScheme(X, D2);
+        return;
+    }
+    
+    D1.create(X.size(), X.type());
+    D2.create(X.size(), X.type());
+    
+    int channels = X.channels();
+    int valuesPerRow = X.cols * channels;
+    
+    for (int y = 0; y < X.rows; ++y)
+    {
+        float const *p_x = X.ptr<float>(y);
+        float const *p_below = X.ptr<float>((y + 1) % X.rows);
+        float *p_d1 = D1.ptr<float>(y);
+        float *p_d2 = D2.ptr<float>(y);
+        
+        for (int j = 0; j < valuesPerRow; ++j)
+        {
+            // The last column wraps around to the first one
+            int right = (j + channels < valuesPerRow ? j + channels : j + channels - valuesPerRow);
+            
+            p_d1[j] = p_x[right] - p_x[j];
+            p_d2[j] = p_below[j] - p_x[j];
+        }
+    }
+}
+
+/**
+ * Divergence, the opposite of the adjoint of SplitBregmanGradient
+ */
+void cds::SplitBregmanDivergence(cv::Mat const &X1, cv::Mat const &X2, int boundary, cv::Mat &divX)
+{
+    if (boundary == TV_BOUNDARY_NEUMANN)
+    {
+        cds::DivergenceWithBackwardScheme(X1, X2, divX);
+        return;
+    }
+    
+    divX.create(X1.size(), X1.type());
+    
+    int channels = X1.channels();
+    int valuesPerRow = X1.cols * channels;
+    
+    for (int y = 0; y < X1.rows; ++y)
+    {
+        float const *p_x1 = X1.ptr<float>(y);
+        float const *p_x2 = X2.ptr<float>(y);
+        float const *p_above = X2.ptr<float>((y + X1.rows - 1) % X1.rows);
+        float *p_div = divX.ptr<float>(y);
+        
+        for (int j = 0; j < valuesPerRow; ++j)
+        {
+            // The first column wraps around to the last one
+            int left = (j >= channels ? j - channels : j - channels + valuesPerRow);
+            
+            p_div[j] = (p_x1[j] - p_x1[left]) + (p_x2[j] - p_above[j]);
+        }
+    }
+}
+
+/**
+ * Isotropic shrinkage of S = D + B, jointly over the channels:
+ * 		d = max(|S| - threshold, 0) S/|S|
+ * then B = S - d and W = d - B.
+ */
+void cds::SplitBregmanShrinkage(cv::Mat const &D1, cv::Mat const &D2, float threshold, cv::Mat &B1, cv::Mat &B2, cv::Mat &W1, cv::Mat &W2)
+{
+    int channels = D1.channels();
+    
+    for (int y = 0; y < D1.rows; ++y)
+    {
+        float const *p_d1 = D1.ptr<float>(y);
+        float const *p_d2 = D2.ptr<float>(y);
+        float *p_b1 = B1.ptr<float>(y);
+        float *p_b2 = B2.ptr<float>(y);
+        float *p_w1 = W1.ptr<float>(y);
+        float *p_w2 = W2.ptr<float>(y);
+        
+        for (int x = 0; x < D1.cols; ++x)
+        {
+            float s1[4];
+            float s2[4];
+            float normS = 0.0f;
+            
+            for (int c = 0; c < channels; ++c)
+            {
+                s1[c] = p_d1[c] + p_b1[c];
+                s2[c] = p_d2[c] + p_b2[c];
+                normS += s1[c]*s1[c] + s2[c]*s2[c];
+            }
+            
+            normS = std::sqrt(normS);
+            float scale = (normS > threshold ? 1.0f - threshold / normS : 0.0f);
+            
+            for (int c = 0; c < channels; ++c)
+            {
+                float d1 = scale * s1[c];
+                float d2 = scale * s2[c];
+                
+                p_b1[c] = s1[c] - d1;
+                p_b2[c] = s2[c] - d2;
+                p_w1[c] = d1 - p_b1[c];
+                p_w2[c] = d2 - p_b2[c];
+            }
+            
+            p_d1 += channels;
+            p_d2 += channels;
+            p_b1 += channels;
+            p_b2 += channels;
+            p_w1 += channels;
+            p_w2 += channels;
+        }
+    }
+}
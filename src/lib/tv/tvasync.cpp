@@ -0,0 +1,316 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/tvasync.hpp>
+
+#include <exception>
+
+#include <sys/time.h>
+
+cds::TvSolveTask::TvSolveTask()
+: deadline_(0.0), snapshotEvery_(0), iterations_(0), lambda_(0.0f), deadlineTicks_(0), snapshotPeriod_(0), lastSnapshot_(0),
+  running_(false), joined_(true), cancelled_(false), interrupted_(false), failed_(false), iteration_(0)
+{
+    pthread_mutex_init(&mutex_, 0);
+    pthread_cond_init(&finished_, 0);
+    
+    solver_.setInterruptCallback(cds::TvSolveTask::Interrupt, this);
+}
+
+cds::TvSolveTask::~TvSolveTask()
+{
+    cancel();
+    join();
+    
+    pthread_cond_destroy(&finished_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+void cds::TvSolveTask::startDiffusion(cv::Mat const &g, int iterations, float lambda, cv::Mat const &u0)
+{
+    start(g, cv::Mat(), iterations, lambda, u0);
+}
+
+void cds::TvSolveTask::startInpainting(cv::Mat const &g, cv::Mat const &mask, int iterations, cv::Mat const &u0)
+{
+    CV_Assert(mask.size() == g.size() && mask.type() == CV_32FC1);
+    
+    start(g, mask, iterations, 0.0f, u0);
+}
+
+void cds::TvSolveTask::start(cv::Mat const &g, cv::Mat const &mask, int iterations, float lambda, cv::Mat const &u0)
+{
+    // Checked here, the errors of the thread can not be reported to the caller
+    CV_Assert(g.data && g.depth() == CV_32F && g.channels() <= 4);
+    
+    cancel();
+    join();
+    
+    // The thread works on its own copies
+    g.copyTo(g_);
+    
+    if (mask.data)
+    {
+        mask.copyTo(mask_);
+    }
+    else
+    {
+        mask_.release();
+    }
+    
+    if (u0.data && u0.size() == g.size() && u0.type() == g.type())
+    {
+        u0.copyTo(u_);
+    }
+    else
+    {
+        u_.release();
+    }
+    
+    iterations_ = iterations;
+    lambda_ = lambda;
+    deadlineTicks_ = (deadline_ > 0.0 ? cv::getTickCount() + (int64)(deadline_ * cv::getTickFrequency()) : 0);
+    snapshotPeriod_ = snapshotEvery_;
+    lastSnapshot_ = 0;
+    
+    // The blocks of the solver end on the snapshots
+    solver_.setInterruptCallback(cds::TvSolveTask::Interrupt, this, snapshotPeriod_);
+    
+    pthread_mutex_lock(&mutex_);
+    running_ = true;
+    cancelled_ = false;
+    interrupted_ = false;
+    failed_ = false;
+    error_.clear();
+    iteration_ = 0;
+    snapshot_.release();
+    pthread_mutex_unlock(&mutex_);
+    
+    if (pthread_create(&thread_, 0, cds::TvSolveTask::Run, this) != 0)
+    {
+        // No thread available: solve on the calling thread
+        run();
+        return;
+    }
+    
+    joined_ = false;
+}
+
+void *cds::TvSolveTask::Run(void *task)
+{
+    static_cast<cds::TvSolveTask *>(task)->run();
+    return 0;
+}
+
+void cds::TvSolveTask::run()
+{
+    // Nothing may escape the thread, the errors are reported to the owner by failed and error
+    bool failed = false;
+    std::string error;
+    
+    try
+    {
+        if (mask_.data)
+        {
+            solver_.solve(g_, mask_, u_, iterations_);
+        }
+        else
+        {
+            solver_.solve(g_, u_, iterations_, lambda_);
+        }
+    }
+    catch (std::exception const &e)
+    {
+        failed = true;
+        error = e.what();
+    }
+    catch (...)
+    {
+        failed = true;
+        error = "unknown error";
+    }
+    
+    pthread_mutex_lock(&mutex_);
+    running_ = false;
+    failed_ = failed;
+    error_ = error;
+    iteration_ = solver_.stats().iteration;
+    pthread_cond_broadcast(&finished_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void cds::TvSolveTask::join()
+{
+    if (!joined_)
+    {
+        pthread_join(thread_, 0);
+        joined_ = true;
+    }
+}
+
+/**
+ * Called by the solver on the thread of the task, after each iteration
+ */
+bool cds::TvSolveTask::Interrupt(int iteration, cv::Mat const &u, void *task)
+{
+    cds::TvSolveTask *self = static_cast<cds::TvSolveTask *>(task);
+    
+    bool late = (self->deadlineTicks_ != 0 && cv::getTickCount() >= self->deadlineTicks_);
+    
+    pthread_mutex_lock(&self->mutex_);
+    
+    self->iteration_ = iteration;
+    
+    // Measured from the last snapshot, so that none is skipped if a block does not end on a multiple of the period
+    if (self->snapshotPeriod_ > 0 && iteration - self->lastSnapshot_ >= self->snapshotPeriod_)
+    {
+        u.copyTo(self->snapshot_);
+        self->lastSnapshot_ = iteration;
+    }
+    
+    bool stop = (late || self->cancelled_) && iteration < self->iterations_;
+    self->interrupted_ = stop;
+    
+    pthread_mutex_unlock(&self->mutex_);
+    
+    return stop;
+}
+
+void cds::TvSolveTask::cancel()
+{
+    pthread_mutex_lock(&mutex_);
+    cancelled_ = true;
+    pthread_mutex_unlock(&mutex_);
+}
+
+bool cds::TvSolveTask::wait(double seconds)
+{
+    pthread_mutex_lock(&mutex_);
+    
+    if (seconds < 0.0)
+    {
+        while (running_)
+        {
+            pthread_cond_wait(&finished_, &mutex_);
+        }
+    }
+    else
+    {
+        // Absolute time of the timeout, on the clock of pthread_cond_timedwait
+        struct timeval now;
+        gettimeofday(&now, 0);
+        
+        double end = now.tv_sec + 1e-6 * now.tv_usec + seconds;
+        
+        struct timespec timeout;
+        timeout.tv_sec = (time_t)end;
+        timeout.tv_nsec = (long)((end - (double)timeout.tv_sec) * 1e9);
+        
+        while (running_)
+        {
+            if (pthread_cond_timedwait(&finished_, &mutex_, &timeout) != 0)
+            {
+                break;
+            }
+        }
+    }
+    
+    bool over = !running_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return over;
+}
+
+bool cds::TvSolveTask::done()
+{
+    pthread_mutex_lock(&mutex_);
+    bool over = !running_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return over;
+}
+
+bool cds::TvSolveTask::interrupted()
+{
+    pthread_mutex_lock(&mutex_);
+    bool stopped = interrupted_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return stopped;
+}
+
+int cds::TvSolveTask::iteration()
+{
+    pthread_mutex_lock(&mutex_);
+    int count = iteration_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return count;
+}
+
+bool cds::TvSolveTask::snapshot(cv::Mat &u)
+{
+    pthread_mutex_lock(&mutex_);
+    
+    bool available = (snapshot_.data != 0);
+    if (available)
+    {
+        snapshot_.copyTo(u);
+    }
+    
+    pthread_mutex_unlock(&mutex_);
+    
+    return available;
+}
+
+bool cds::TvSolveTask::failed()
+{
+    pthread_mutex_lock(&mutex_);
+    bool failure = failed_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return failure;
+}
+
+std::string cds::TvSolveTask::error()
+{
+    pthread_mutex_lock(&mutex_);
+    std::string message = error_;
+    pthread_mutex_unlock(&mutex_);
+    
+    return message;
+}
+
+bool cds::TvSolveTask::result(cv::Mat &u)
+{
+    wait();
+    join();
+    
+    if (failed_)
+    {
+        return false;
+    }
+    
+    u_.copyTo(u);
+    return true;
+}
@@ -0,0 +1,281 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/tvsolver.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// POSIX, for the durable writes and the memory mapping of the checkpoints
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cds
+{
+    /**
+     * Layout of the header of the checkpoints, padded to 64 bytes so that the planes that follow it
+     * are aligned in a memory-mapped file
+     */
+    struct TvCheckpointHeader
+    {
+        char magic[8];
+        int rows;
+        int cols;
+        int type;
+        int storage;
+        int problem;
+        int iteration;
+        float lambda;
+        float tau;
+        float sigma;
+        int blockDepth;
+        int preconditioning;
+        char padding[12];
+    };
+    
+    char const TvCheckpointMagic[8] = { 'C', 'D', 'S', 'T', 'V', 'C', 'K', '2' };
+    
+    /**
+     * Writes a buffer to a file descriptor, through the partial writes and the interruptions
+     */
+    bool WriteAll(int fd, void const *data, size_t size);
+    
+    /**
+     * Writes the rows of a matrix one after the other
+     */
+    bool WritePlane(int fd, cv::Mat const &plane);
+    
+    /**
+     * Flushes the directory of a file to the disk, so that a rename in it is durable
+     */
+    bool SyncDirectory(std::string const &filename);
+}
+
+bool cds::WriteAll(int fd, void const *data, size_t size)
+{
+    char const *bytes = static_cast<char const *>(data);
+    
+    while (size > 0)
+    {
+        ssize_t written = write(fd, bytes, size);
+        
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        
+        if (written <= 0)
+        {
+            return false;
+        }
+        
+        bytes += written;
+        size -= (size_t)written;
+    }
+    
+    return true;
+}
+
+bool cds::WritePlane(int fd, cv::Mat const &plane)
+{
+    size_t rowSize = plane.cols * plane.elemSize();
+    
+    for (int y = 0; y < plane.rows; ++y)
+    {
+        if (!cds::WriteAll(fd, plane.ptr(y), rowSize))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool cds::SyncDirectory(std::string const &filename)
+{
+    size_t slash = filename.find_last_of('/');
+    std::string directory = (slash == std::string::npos ? "." : (slash == 0 ? "/" : filename.substr(0, slash)));
+    
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    
+    bool synced = (fsync(fd) == 0);
+    close(fd);
+    
+    return synced;
+}
+
+void cds::TvSolver::setCheckpoint(std::string const &filename, int every)
+{
+    CV_Assert(every >= 0);
+    
+    checkpointFile_ = filename;
+    checkpointEvery_ = every;
+}
+
+void cds::TvSolver::checkpoint(cv::Mat const &u)
+{
+    if (checkpointEvery_ <= 0 || checkpointFile_.empty() || stats_.iteration % checkpointEvery_ != 0)
+    {
+        return;
+    }
+    
+    if (!save(checkpointFile_, u))
+    {
+        checkpointFailed_ = true;
+    }
+}
+
+bool cds::TvSolver::save(std::string const &filename, cv::Mat const &u) const
+{
+    if (!bands_ || u.size() != frameSize_ || u.type() != type_)
+    {
+        return false;
+    }
+    
+    cds::TvCheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cds::TvCheckpointMagic, sizeof(header.magic));
+    header.rows = frameSize_.height;
+    header.cols = frameSize_.width;
+    header.type = type_;
+    header.storage = storage_;
+    header.problem = problem_;
+    header.iteration = stats_.iteration;
+    header.lambda = lambda_;
+    header.tau = tau_;
+    header.sigma = sigma_;
+    header.blockDepth = blockDepth_;
+    header.preconditioning = preconditioning_ ? 1 : 0;
+    
+    // Written next to the destination, flushed to the disk and renamed, so that the previous
+    // checkpoint stays valid until the new one is complete, even if the machine goes down
+    std::string temporary = filename + ".tmp";
+    
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    
+    bool written = cds::WriteAll(fd, &header, sizeof(header))
+                && cds::WritePlane(fd, u) && cds::WritePlane(fd, ubar_) && cds::WritePlane(fd, p1_) && cds::WritePlane(fd, p2_)
+                && fsync(fd) == 0;
+    written = (close(fd) == 0) && written;
+    
+    if (!written)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    
+    return cds::SyncDirectory(filename);
+}
+
+bool cds::TvSolver::load(std::string const &filename, cv::Mat &u)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(cds::TvCheckpointHeader))
+    {
+        close(fd);
+        return false;
+    }
+    
+    size_t fileSize = (size_t)status.st_size;
+    void *mapping = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    
+    cds::TvCheckpointHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    
+    bool valid = std::memcmp(header.magic, cds::TvCheckpointMagic, sizeof(header.magic)) == 0
+              && header.rows > 0 && header.cols > 0
+              && CV_MAT_DEPTH(header.type) == CV_32F && CV_MAT_CN(header.type) <= 4
+              && (header.storage == TV_STORAGE_FLOAT32 || header.storage == TV_STORAGE_FLOAT16 || header.storage == TV_STORAGE_BFLOAT16)
+              && header.problem >= PROBLEM_ROF && header.problem <= PROBLEM_INPAINTING_PRECONDITIONED
+              && header.iteration >= 0;
+    
+    // Only resumed by a solver set up like the one that wrote it, and not for the solves with policies
+    // The temporal blocking gives the same iterates, so the block depth (recorded for information) may differ
+    valid = valid && header.problem != PROBLEM_GENERIC
+          && header.storage == storage_ && header.preconditioning == (preconditioning_ ? 1 : 0);
+    
+    int stateType = (header.storage == TV_STORAGE_FLOAT32 ? header.type : CV_MAKETYPE(CV_16U, CV_MAT_CN(header.type)));
+    size_t uSize = (size_t)header.rows * header.cols * CV_ELEM_SIZE(header.type);
+    size_t stateSize = (size_t)header.rows * header.cols * CV_ELEM_SIZE(stateType);
+    
+    if (!valid || fileSize != sizeof(header) + uSize + 3 * stateSize)
+    {
+        munmap(mapping, fileSize);
+        return false;
+    }
+    
+    // The planes are read in place from the mapping, and copied to the workspace
+    uchar *planes = static_cast<uchar *>(mapping) + sizeof(header);
+    cv::Size frameSize(header.cols, header.rows);
+    
+    create(frameSize, header.type, header.storage);
+    
+    cv::Mat(frameSize, header.type, planes).copyTo(u);
+    planes += uSize;
+    cv::Mat(frameSize, stateType, planes).copyTo(ubar_);
+    planes += stateSize;
+    cv::Mat(frameSize, stateType, planes).copyTo(p1_);
+    planes += stateSize;
+    cv::Mat(frameSize, stateType, planes).copyTo(p2_);
+    
+    munmap(mapping, fileSize);
+    
+    problem_ = header.problem;
+    lambda_ = header.lambda;
+    tau_ = header.tau;
+    sigma_ = header.sigma;
+    stats_ = cds::TvStats();
+    stats_.iteration = header.iteration;
+    resume_ = true;
+    
+    return true;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2012 D'ANGELO Emmanuel
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this list of conditions 
+//   and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+//   and the following disclaimer in the documentation and/or other materials provided with the distribution.
+// * Neither the name of the copyright holder nor the names of its contributors may be used 
+//   to endorse or promote products derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cds/tv/tvstream.hpp>
+
+cds::TvDiffusionStream::TvDiffusionStream(int iterations, float lambda, int firstIterations, float cutThreshold, int tileSize)
+: iterations_(iterations), lambda_(lambda), firstIterations_(firstIterations), cutThreshold_(cutThreshold),
+  tileSize_(MAX(1, tileSize)), started_(false), restartedTiles_(0)
+{
+}
+
+void cds::TvDiffusionStream::operator()(cv::Mat const &frame, cv::Mat &u)
+{
+    if (!frame.data)
+    {
+        return;
+    }
+    
+    CV_Assert(frame.depth() == CV_32F && frame.channels() <= 4);
+    
+    if (started_ && (previous_.size() != frame.size() || previous_.type() != frame.type()))
+    {
+        reset();
+    }
+    
+    restartedTiles_ = 0;
+    bool warm = started_ && (cutThreshold_ <= 0.0f || detectCuts(frame));
+    
+    // The accelerated solver restarts with fresh steps from the kept state, which pays off much more
+    // than algorithm 1 from the same state
+    if (warm)
+    {
+        solver_.keepState();
+        solver_.solveAccelerated(frame, u_, iterations_, lambda_);
+    }
+    else
+    {
+        // Cold start from the frame itself
+        frame.copyTo(u_);
+        solver_.solveAccelerated(frame, u_, firstIterations_, lambda_);
+    }
+    
+    started_ = true;
+    frame.copyTo(previous_);
+    u_.copyTo(u);
+}
+
+bool cds::TvDiffusionStream::detectCuts(cv::Mat const &frame)
+{
+    cv::absdiff(frame, previous_, difference_);
+    
+    int tiles = 0;
+    
+    for (int y = 0; y < frame.rows; y += tileSize_)
+    {
+        for (int x = 0; x < frame.cols; x += tileSize_)
+        {
+            cv::Rect tile(x, y, MIN(tileSize_, frame.cols - x), MIN(tileSize_, frame.rows - y));
+            
+            // Mean over the pixels and the channels
+            cv::Scalar mean = cv::mean(difference_(tile));
+            double difference = (mean[0] + mean[1] + mean[2] + mean[3]) / frame.channels();
+            
+            if (difference > cutThreshold_)
+            {
+                solver_.restart(frame, u_, tile);
+                ++restartedTiles_;
+            }
+            
+            ++tiles;
+        }
+    }
+    
+    return restartedTiles_ < tiles;
+}
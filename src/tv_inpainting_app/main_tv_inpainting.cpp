@@ -32,39 +32,96 @@
 
 using namespace cds;
 
+static void PrintUsage(char const *program)
+{
+	std::cerr << "Usage: " << program << "[-d [-a|-b] -e -H -l -m levels -n -p -i iterations -t tolerance] anImage\n";
+}
+
 int main(int argc, char * const argv[])
 {
 	if (argc < 2)
 	{
 		std::cerr << "Missing image!\n";
-		std::cerr << "Usage: " << argv[0] << "[-d -i iterations] anImage\n";
+		PrintUsage(argv[0]);
 		return EXIT_FAILURE;
 	}
 
 	int iterations = 100;
+	int levels = 1;
+	double tolerance = 0.0;
 	bool use_diffusion = false;
+	bool use_exemplar = false;
+	bool use_harmonic = false;
+	bool use_harmonic_start = false;
+	bool use_acceleration = false;
+	bool use_split_bregman = false;
+	bool use_narrow_band = false;
+	bool use_preconditioning = false;
 	bool separate_windows = false;
 	
 	int option;
 	
-	while ((option = getopt(argc, argv, "di:s")) != -1)
+	while ((option = getopt(argc, argv, "abdeHi:lm:npst:")) != -1)
 	{
 		switch (option)
 		{
+		case 'a':
+			use_acceleration = true;
+			break;
+		case 'b':
+			use_split_bregman = true;
+			break;
 		case 'd':
 			use_diffusion = true;
 			break;
+		case 'e':
+			use_exemplar = true;
+			break;
+		case 'H':
+			use_harmonic_start = true;
+			break;
 		case 'i':
 			iterations = atoi(optarg);
 			break;
+		case 'l':
+			use_harmonic = true;
+			break;
+		case 'm':
+			levels = atoi(optarg);
+			break;
+		case 'n':
+			use_narrow_band = true;
+			break;
+		case 'p':
+			use_preconditioning = true;
+			break;
 		case 's':
 			separate_windows = true;
 			break;
+		case 't':
+			tolerance = atof(optarg);
+			break;
 		default:
 			break;
 		}
 	}
 	
+	// Preconditioning only exists in the single-scale TV inpainting solver
+	if (use_preconditioning && (use_diffusion || use_exemplar || use_harmonic || levels > 1 || use_narrow_band))
+	{
+		std::cerr << "-p only applies to TV inpainting, it can not be combined with -d, -e, -l, -m or -n\n";
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	// Same for the harmonic starting point
+	if (use_harmonic_start && (use_diffusion || use_exemplar || use_harmonic || levels > 1 || use_narrow_band))
+	{
+		std::cerr << "-H only applies to TV inpainting, it can not be combined with -d, -e, -l, -m or -n\n";
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	
 	// Read an image from the command line
 	cv::Mat inputImage = cv::imread(argv[argc-1], 0);
 		if (!inputImage.data)
@@ -115,18 +172,85 @@ int main(int argc, char * const argv[])
 	// For each image, reconstruct it
 	std::cout << "Reconstruction...\n";
 	std::vector<cv::Mat> reconstructionResults(masks.size());
-	for (int i = 0; i < masks.size(); ++i)
+	int64 startTicks = cv::getTickCount();
+	
+	if (use_exemplar)
+	{
+		// Patch-based filling, coarse to fine
+		for (int i = 0; i < masks.size(); ++i)
+		{
+			ExemplarInpainting(maskedInputs[i], masks[i], reconstructionResults[i]);
+		}
+	}
+	else if (use_harmonic)
 	{
-		// Diffuse
-		if (use_diffusion)
+		// Multigrid solve of the Laplace equation on the holes
+		for (int i = 0; i < masks.size(); ++i)
 		{
-			TvDiffusion(maskedInputs[i], reconstructionResults[i], iterations, 10);
+			HarmonicInpainting(maskedInputs[i], masks[i], reconstructionResults[i]);
 		}
-		else
+	}
+	else if (use_diffusion && use_split_bregman)
+	{
+		for (int i = 0; i < masks.size(); ++i)
+		{
+			TvDiffusionSplitBregman(maskedInputs[i], reconstructionResults[i], iterations, 10);
+		}
+	}
+	else if ((tolerance > 0.0 || use_preconditioning || use_harmonic_start) && levels <= 1 && !use_narrow_band)
+	{
+		// Iterations become a maximum, the solver stops on the relative primal-dual gap
+		TvSolver solver(frameSize, CV_32FC1);
+		solver.setStopping(tolerance);
+		solver.setPreconditioning(use_preconditioning);
+		solver.setHarmonicStart(use_harmonic_start);
+		
+		for (int i = 0; i < masks.size(); ++i)
 		{
-			TvInpainting(maskedInputs[i], masks[i], reconstructionResults[i], iterations);
+			if (use_diffusion && use_acceleration)
+			{
+				solver.solveAccelerated(maskedInputs[i], reconstructionResults[i], iterations, 10);
+			}
+			else if (use_diffusion)
+			{
+				solver.solve(maskedInputs[i], reconstructionResults[i], iterations, 10);
+			}
+			else
+			{
+				solver.solve(maskedInputs[i], masks[i], reconstructionResults[i], iterations);
+			}
+			
+			std::cout << "Stopped after " << solver.stats().iteration << " iterations, relative gap = " << solver.stats().relativeGap << std::endl;
 		}
 	}
+	else if (use_diffusion && !use_acceleration)
+	{
+		TvDiffusionBatch(maskedInputs, reconstructionResults, iterations, 10);
+	}
+	else if (!use_diffusion && levels <= 1 && !use_narrow_band)
+	{
+		TvInpaintingBatch(maskedInputs, masks, reconstructionResults, iterations);
+	}
+	else
+	{
+		for (int i = 0; i < masks.size(); ++i)
+		{
+			if (use_diffusion)
+			{
+				TvDiffusionAccelerated(maskedInputs[i], reconstructionResults[i], iterations, 10);
+			}
+			else if (use_narrow_band)
+			{
+				TvInpaintingNarrowBand(maskedInputs[i], masks[i], reconstructionResults[i], iterations);
+			}
+			else
+			{
+				TvInpaintingMultiscale(maskedInputs[i], masks[i], reconstructionResults[i], iterations, levels, iterations);
+			}
+		}
+	}
+	
+	std::cout << "Reconstruction time: " << (cv::getTickCount() - startTicks) / cv::getTickFrequency() << " s\n";
 	
 	// SNR measures 
 	std::vector<double> snr_before;
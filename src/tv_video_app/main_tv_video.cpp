@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cds/tv/tv.hpp>
+
+int main(int argc, char * const argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Missing video!\n";
+    std::cerr << "Usage: " << argv[0] << " [-k frames | -w [-c cut]] [-i iterations -l lambda -n noise] aVideo\n";
+    return EXIT_FAILURE;
+  }
+
+  int windowSize = 5;
+  int iterations = 20;
+  float lambda = 10.0f;
+  float noise = 0.0f;
+  bool warmStart = false;
+  float cutThreshold = 0.0f;
+
+  int option;
+
+  while ((option = getopt(argc, argv, "c:i:k:l:n:w")) != -1)
+  {
+    switch (option)
+    {
+    case 'c':
+      cutThreshold = (float)atof(optarg);
+      break;
+    case 'i':
+      iterations = atoi(optarg);
+      break;
+    case 'k':
+      windowSize = atoi(optarg);
+      break;
+    case 'l':
+      lambda = (float)atof(optarg);
+      break;
+    case 'n':
+      noise = (float)atof(optarg);
+      break;
+    case 'w':
+      warmStart = true;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Read input video from the command line
+  cv::VideoCapture inputMovie;
+  bool success = inputMovie.open(argv[argc-1]);
+  if (!success)
+  {
+    std::cerr << "Failed to open: " << argv[argc-1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  cv::namedWindow("Original", CV_WINDOW_KEEPRATIO);
+  cv::namedWindow("Denoised", CV_WINDOW_KEEPRATIO);
+
+  // Only the last frames are kept in memory, one frame is denoised per input frame
+  cds::SpatioTemporalTvDiffusion denoiser(windowSize, iterations, lambda);
+  
+  // Or frame by frame, each frame starting from the state of the previous one
+  cds::TvDiffusionStream streamDenoiser(iterations, lambda, 100, cutThreshold);
+
+  cv::Mat currentFrame;
+  cv::Mat frame32;
+  cv::Mat denoised;
+
+  // Main loop
+  inputMovie >> currentFrame;
+  while(currentFrame.data)
+  {
+    currentFrame.convertTo(frame32, CV_32F, 1.0/255.0);
+
+    // Optional synthetic noise, to see the effect of the temporal regularization
+    if (noise > 0.0f)
+    {
+      cv::Mat gaussianNoise(frame32.size(), frame32.type());
+      cv::randn(gaussianNoise, cv::Scalar::all(0), cv::Scalar::all(noise));
+      frame32 += gaussianNoise;
+    }
+
+    if (warmStart)
+    {
+      streamDenoiser(frame32, denoised);
+    }
+    else
+    {
+      denoiser(frame32, denoised);
+    }
+
+    cv::imshow("Original", frame32);
+    cv::imshow("Denoised", denoised);
+
+    // Next frame
+    int key = cv::waitKey(1);
+    if (key != 27)
+    {
+      inputMovie >> currentFrame;
+    }
+    else
+    {
+      currentFrame.release();
+    }
+  }
+
+  // Done, exit
+  return EXIT_SUCCESS;
+}